@@ -2,7 +2,9 @@
 // Created by Noah Turnquist on 7/22/24.
 //
 
+#include <atomic>
 #include <fstream>
+#include <ranges>
 #include "gtest/gtest.h"
 #include <opencv2/opencv.hpp>
 #include "../quest_seq_lib.h"
@@ -10,6 +12,8 @@
 class ImageSeqLibTest : public testing::Test {
 protected:
     void SetUp() override {
+        Quest::EnableOpenExr();
+        saved_max_threads = Quest::ThreadPool::get_max_threads();
         dog_seq.open(small_dog_seq_path);
         dog_seq_alpha.open(small_dog_alpha_path);
         dog_seq_identical.open(small_dog_seq_path);
@@ -22,6 +26,9 @@ protected:
     }
 
     void TearDown() override {
+        // Undo any thread cap a test set, even one that failed part way
+        Quest::ThreadPool::set_max_threads(saved_max_threads);
+
         // Remove rendered dog sequence
         Quest::SeqPath teardown_output_seq(small_dog_output_path);
         for (int i = 1; i < 188; i++) {
@@ -50,6 +57,8 @@ protected:
         }
     }
 
+    int saved_max_threads = 0;
+
     std::filesystem::path small_dog_seq_path =
         "../../media/test_media/videos/image_sequences/small_dog_001/small_dog_001_%04d.png";
 
@@ -82,7 +91,7 @@ protected:
         "../../media/test_media/images/all_image_extensions_compare/dandelion_%04d.jpg";
 
     std::filesystem::path dandelion_unsupported_path =
-        "../../media/test_media/images/unsupported_extensions/dandelion_%04d.dpx";
+        "../../media/test_media/images/unsupported_extensions/dandelion_%04d.cin";
 
     std::filesystem::path wave_path =
     "../../media/test_media/videos/image_sequences/waves_001_shorter/waves_001_%04d.png";
@@ -259,6 +268,138 @@ TEST_F(ImageSeqLibTest, TestImageSeqOpenMethodSuccessVideoFiles) {
     ASSERT_NEAR(high_fps.get_fps(), 119.88, 0.1);
 }
 
+// Long videos are decoded in segments on separate captures, the result should match a plain serial decode
+TEST_F(ImageSeqLibTest, TestImageSeqOpenVideoSegmentsMatchSerialDecode) {
+    cv::VideoCapture capture(video_file_path);
+    ASSERT_TRUE(capture.isOpened());
+    ASSERT_EQ(video_seq.get_frame_count(), static_cast<int>(capture.get(cv::CAP_PROP_FRAME_COUNT)));
+    for (int i = 0; i < video_seq.get_frame_count(); i++) {
+        cv::Mat frame;
+        ASSERT_TRUE(capture.read(frame));
+        Quest::GiveMatPureWhiteAlpha(frame);
+        ASSERT_TRUE(Quest::MatEquals(frame, video_seq[i]));
+    }
+}
+
+// Arena allocated frames should hold the same pixels as individually allocated ones, all inside the one arena
+TEST_F(ImageSeqLibTest, TestImageSeqOpenArenaAllocation) {
+    const std::vector<std::pair<std::filesystem::path, Quest::ImageSeq*>> inputs =
+        {{small_dog_seq_path, &dog_seq}, {video_file_path, &video_seq}};
+    for (const auto& [path, expected] : inputs) {
+        Quest::ImageSeq arena_seq;
+        arena_seq.set_allocation(Quest::FrameAllocation::Arena);
+        ASSERT_EQ(arena_seq.open(path), Quest::SeqErrorCodes::Success);
+        ASSERT_EQ(arena_seq, *expected);
+
+        const cv::Mat arena = arena_seq.get_arena();
+        ASSERT_FALSE(arena.empty());
+        ASSERT_TRUE(arena.isContinuous());
+        for (const auto& frame : arena_seq) {
+            ASSERT_GE(frame.data, arena.data);
+            ASSERT_LE(frame.data + frame.total() * frame.elemSize(), arena.data + arena.total());
+        }
+
+        // Copies get frames of their own
+        ASSERT_TRUE(Quest::ImageSeq(arena_seq).get_arena().empty());
+    }
+}
+
+// Compressed frames should decode to exactly what was opened, with only the hot cache held decoded
+TEST_F(ImageSeqLibTest, TestImageSeqCompressedStorage) {
+    Quest::ImageSeq compressed_seq;
+    compressed_seq.set_storage(Quest::FrameStorage::Compressed);
+    compressed_seq.set_hot_cache_frames(2);
+    ASSERT_EQ(compressed_seq.open(small_dog_seq_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(compressed_seq.get_width(), dog_seq.get_width());
+    ASSERT_EQ(compressed_seq, dog_seq);
+    for (int i = 0; i < dog_seq.get_frame_count(); i++) {
+        ASSERT_TRUE(Quest::MatEquals(compressed_seq.get_frame(i), dog_seq[i]));
+    }
+
+    // Changes made through references survive the frame leaving the hot cache
+    for (cv::Mat& frame : compressed_seq) {
+        GaussianBlur(frame, frame, cv::Size(25, 25), 0, 0, cv::BORDER_CONSTANT);
+        Quest::GiveMatPureWhiteAlpha(frame);
+    }
+    ASSERT_EQ(compressed_seq, dog_blurred);
+
+    // Converting back decodes everything, and renders match either way
+    compressed_seq.set_storage(Quest::FrameStorage::Decoded);
+    ASSERT_EQ(compressed_seq, dog_blurred);
+    dog_blurred.set_storage(Quest::FrameStorage::Compressed);
+    ASSERT_EQ(dog_blurred.render(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    Quest::ImageSeq rendered;
+    rendered.open(small_dog_output_path);
+    ASSERT_EQ(rendered, compressed_seq);
+}
+
+// Frames over the memory budget are spilled to disk and paged back in on access without changing
+TEST_F(ImageSeqLibTest, TestImageSeqMemoryBudgetSpillsFrames) {
+    const size_t frame_bytes = dog_seq[0].total() * dog_seq[0].elemSize();
+    Quest::ImageSeq budget_seq;
+    budget_seq.set_memory_budget(3 * frame_bytes);
+    ASSERT_EQ(budget_seq.open(small_dog_seq_path), Quest::SeqErrorCodes::Success);
+    ASSERT_LE(budget_seq.get_resident_bytes(), 3 * frame_bytes);
+    ASSERT_EQ(budget_seq, dog_seq);
+    ASSERT_LE(budget_seq.get_resident_bytes(), 3 * frame_bytes);
+
+    // Changed frames are written back when they're spilled again, and copies get their own spill file
+    for (cv::Mat& frame : budget_seq) {
+        GaussianBlur(frame, frame, cv::Size(25, 25), 0, 0, cv::BORDER_CONSTANT);
+        Quest::GiveMatPureWhiteAlpha(frame);
+    }
+    ASSERT_EQ(budget_seq, dog_blurred);
+    const Quest::ImageSeq copied_seq = budget_seq;
+    ASSERT_EQ(copied_seq, dog_blurred);
+
+    // Lowering the budget on a sequence that's already open spills straight away
+    dog_seq_identical.set_memory_budget(frame_bytes);
+    ASSERT_LE(dog_seq_identical.get_resident_bytes(), frame_bytes);
+    ASSERT_EQ(dog_seq_identical, dog_seq);
+}
+
+// A copy whose scratch directory can't be written keeps the spilled frames decoded rather than losing them
+TEST_F(ImageSeqLibTest, TestImageSeqCopyWithoutScratchSpace) {
+    const size_t frame_bytes = dog_seq[0].total() * dog_seq[0].elemSize();
+    Quest::ImageSeq budget_seq;
+    budget_seq.set_memory_budget(3 * frame_bytes);
+    ASSERT_EQ(budget_seq.open(small_dog_seq_path), Quest::SeqErrorCodes::Success);
+    ASSERT_LE(budget_seq.get_resident_bytes(), 3 * frame_bytes);
+
+    budget_seq.set_scratch_directory(video_output_path.parent_path() / "missing_scratch");
+    const Quest::ImageSeq copied_seq = budget_seq;
+    ASSERT_EQ(copied_seq.get_resident_bytes(), budget_seq.get_frame_count() * frame_bytes);
+    ASSERT_EQ(copied_seq, dog_seq);
+}
+
+// Lazy sequences read frames as they're reached, with the next few read ahead while playing either way
+TEST_F(ImageSeqLibTest, TestImageSeqLazyStoragePrefetch) {
+    const size_t frame_bytes = dog_seq[0].total() * dog_seq[0].elemSize();
+    Quest::ImageSeq lazy_seq;
+    lazy_seq.set_storage(Quest::FrameStorage::Lazy);
+    lazy_seq.set_prefetch_window(4);
+    ASSERT_EQ(lazy_seq.open(small_dog_seq_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(lazy_seq.get_frame_count(), dog_seq.get_frame_count());
+    ASSERT_EQ(lazy_seq.get_resident_bytes(), frame_bytes);
+
+    for (int i = 0; i < lazy_seq.get_frame_count(); i++) {
+        ASSERT_TRUE(Quest::MatEquals(lazy_seq[i], dog_seq[i]));
+        ASSERT_LE(lazy_seq.get_resident_bytes(), Quest::default_hot_cache_frames * frame_bytes);
+    }
+    for (int i = lazy_seq.get_frame_count() - 1; i >= 0; i--) {
+        ASSERT_TRUE(Quest::MatEquals(lazy_seq[i], dog_seq[i]));
+    }
+
+    // Changed frames can't be read back from the input, so they stay decoded
+    lazy_seq.set_frame(5, new_frame);
+    for (int i = 100; i < 120; i++) static_cast<void>(lazy_seq[i]);
+    ASSERT_TRUE(Quest::MatEquals(lazy_seq[5], new_frame));
+
+    lazy_seq.set_storage(Quest::FrameStorage::Decoded);
+    ASSERT_TRUE(Quest::MatEquals(lazy_seq[5], new_frame));
+    ASSERT_TRUE(Quest::MatEquals(lazy_seq[150], dog_seq[150]));
+}
+
 TEST_F(ImageSeqLibTest, TestImageSeqOpenMethodFailureVideoBadPath) {
     Quest::ImageSeq seq;
     ASSERT_EQ(seq.open("badpath/badpath.mp4"), Quest::SeqErrorCodes::BadPath);
@@ -319,6 +460,84 @@ TEST_F(ImageSeqLibTest, TestImageSeqRenderSuccess) {
     }
 }
 
+// An interrupted render leaves only complete frames, and resuming it keeps them rather than writing them again
+TEST_F(ImageSeqLibTest, TestImageSeqRenderResume) {
+    const auto has_record = [&] {
+        for (const auto& entry : std::filesystem::directory_iterator(small_dog_output_path.parent_path())) {
+            if (entry.path().extension() == ".render") return true;
+        }
+        return false;
+    };
+    // Renders without resume don't keep a record
+    const Quest::CancelToken unrecorded_cancel;
+    ASSERT_EQ(dog_seq.render(small_dog_output_path, Quest::RenderOptions(),
+        [&](const int done, int) { if (done == 50) unrecorded_cancel.cancel(); }, unrecorded_cancel),
+        Quest::SeqErrorCodes::Cancelled);
+    ASSERT_FALSE(has_record());
+
+    Quest::RenderOptions options;
+    options.resume = true;
+    const Quest::CancelToken cancel;
+    ASSERT_EQ(dog_seq.render(small_dog_output_path, options,
+        [&](const int done, int) { if (done == 50) cancel.cancel(); }, cancel), Quest::SeqErrorCodes::Cancelled);
+    ASSERT_TRUE(has_record());
+    const std::filesystem::path first_frame_path = output_seq->outputPath();
+    ASSERT_TRUE(std::filesystem::exists(first_frame_path));
+    const std::filesystem::file_time_type first_frame_time = std::filesystem::last_write_time(first_frame_path);
+
+    ASSERT_EQ(dog_seq.render(small_dog_output_path, options), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(std::filesystem::last_write_time(first_frame_path), first_frame_time);
+    Quest::ImageSeq rendered;
+    ASSERT_EQ(rendered.open(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(rendered, dog_seq);
+    for (const auto& entry : std::filesystem::directory_iterator(small_dog_output_path.parent_path())) {
+        ASSERT_EQ(entry.path().filename().string().find(".partial"), std::string::npos);
+        ASSERT_NE(entry.path().extension(), ".render");
+    }
+}
+
+// Rendering back to the same path only writes the frames changed since the last render
+TEST_F(ImageSeqLibTest, TestImageSeqRenderIncremental) {
+    ASSERT_EQ(dog_seq.render(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(dog_seq.get_dirty_frame_count(), 0);
+    int rows = 0;
+    for (cv::Mat& frame : dog_seq) rows += frame.rows;
+    ASSERT_EQ(rows, dog_seq.get_frame_count() * dog_seq.get_height());
+    ASSERT_EQ(dog_seq.get_dirty_frame_count(), 0);
+    const std::filesystem::path first_frame_path = output_seq->outputPath();
+    const std::filesystem::file_time_type first_frame_time = std::filesystem::last_write_time(first_frame_path);
+
+    cv::Mat blurred;
+    for (const int i : {5, 50, 150}) {
+        cv::GaussianBlur(dog_seq.get_frame(i), blurred, cv::Size(25, 25), 0);
+        dog_seq.set_frame(i, blurred.clone());
+    }
+    ASSERT_EQ(dog_seq.get_dirty_frame_count(), 3);
+
+    int progress_done = 0;
+    ASSERT_EQ(dog_seq.render(small_dog_output_path, Quest::RenderOptions(),
+        [&](const int done, int) { progress_done = done; }), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(progress_done, dog_seq.get_frame_count());
+    ASSERT_EQ(dog_seq.get_dirty_frame_count(), 0);
+    ASSERT_EQ(std::filesystem::last_write_time(first_frame_path), first_frame_time);
+    Quest::ImageSeq rendered;
+    ASSERT_EQ(rendered.open(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(rendered, dog_seq);
+
+    // Opened files are only known to match the default options, so other settings write every frame again
+    Quest::RenderOptions options;
+    options.png_compression = 1;
+    ASSERT_EQ(rendered.render(small_dog_output_path, options), Quest::SeqErrorCodes::Success);
+    ASSERT_NE(std::filesystem::last_write_time(first_frame_path), first_frame_time);
+
+    // A copy doesn't know what's happened to the files since, so it writes every frame again too
+    const std::filesystem::file_time_type options_frame_time = std::filesystem::last_write_time(first_frame_path);
+    Quest::ImageSeq copied_seq = rendered;
+    ASSERT_EQ(copied_seq.get_dirty_frame_count(), 0);
+    ASSERT_EQ(copied_seq.render(small_dog_output_path, options), Quest::SeqErrorCodes::Success);
+    ASSERT_NE(std::filesystem::last_write_time(first_frame_path), options_frame_time);
+}
+
 TEST_F(ImageSeqLibTest, TestImageSeqRenderNoFrames) {
     Quest::ImageSeq empty_seq;
     ASSERT_THROW(empty_seq.render(small_dog_output_path), Quest::SeqException);
@@ -350,6 +569,20 @@ TEST_F(ImageSeqLibTest, TestImageSeqRenderSuccessVideoFile) {
     }
 }
 
+// Frames that don't match the video's size are resized on the conversion stage rather than dropped by the encoder
+TEST_F(ImageSeqLibTest, TestImageSeqRenderVideoFileResizesMismatchedFrames) {
+    cv::Mat small_frame;
+    cv::resize(video_seq[10], small_frame, cv::Size(), 0.5, 0.5, cv::INTER_AREA);
+    video_seq.set_frame(10, small_frame);
+
+    ASSERT_EQ(video_seq.render(video_output_path), Quest::SeqErrorCodes::Success);
+    Quest::ImageSeq open_seq;
+    open_seq.open(video_output_path);
+    ASSERT_EQ(open_seq.get_frame_count(), 125);
+    ASSERT_EQ(open_seq[10].cols, 720);
+    ASSERT_EQ(open_seq[10].rows, 1280);
+}
+
 TEST_F(ImageSeqLibTest, TestImageSeqRenderFailureVideoUnsupportedExtension) {
     video_output_path.replace_extension(".flv");
     ASSERT_EQ(video_seq.render(video_output_path), Quest::SeqErrorCodes::UnsupportedExtension);
@@ -372,12 +605,308 @@ TEST_F(ImageSeqLibTest, TestImageSeqRenderWithoutFramePaddingOneImage) {
     ASSERT_EQ(open_seq.get_height(), 427);
 }
 
+TEST_F(ImageSeqLibTest, TestImageSeqRenderOptionsPngCompression) {
+    Quest::ImageSeq pic_seq;
+    pic_seq.open(house_picture_path);
+
+    Quest::RenderOptions fast_options;
+    fast_options.png_compression = 0;
+    ASSERT_EQ(pic_seq.render(single_image_output_path, fast_options), Quest::SeqErrorCodes::Success);
+    const auto uncompressed_size = std::filesystem::file_size(single_image_output_path);
+
+    Quest::RenderOptions small_options;
+    small_options.png_compression = 9;
+    ASSERT_EQ(pic_seq.render(single_image_output_path, small_options), Quest::SeqErrorCodes::Success);
+    ASSERT_LT(std::filesystem::file_size(single_image_output_path), uncompressed_size);
+
+    // Compression level must not change the pixels that get written
+    Quest::ImageSeq open_seq;
+    open_seq.open(single_image_output_path);
+    ASSERT_EQ(open_seq, pic_seq);
+}
+
+TEST_F(ImageSeqLibTest, TestImageSeqRenderOptionsBadVideoCodec) {
+    Quest::RenderOptions options;
+    options.video_codec = "H26";
+    ASSERT_THROW(video_seq.render(video_output_path, options), Quest::SeqException);
+
+    // The video codec only matters for video outputs
+    Quest::ImageSeq pic_seq;
+    pic_seq.open(house_picture_path);
+    ASSERT_EQ(pic_seq.render(single_image_output_path, options), Quest::SeqErrorCodes::Success);
+}
+
 TEST_F(ImageSeqLibTest, TestImageSeqRenderWithoutFramePaddingTooManyFrames) {
     ASSERT_EQ(dog_seq.render("../../media/test_media/videos/image_sequences/small_dog_001/small_dog_001.png"),
         Quest::SeqErrorCodes::BadPath);
     ASSERT_EQ(dog_seq.get_output_path(), "");
 }
 
+// Raw frame format round trip
+TEST_F(ImageSeqLibTest, TestImageSeqRenderAndOpenRawSequence) {
+    const std::filesystem::path raw_output_path = video_output_path.parent_path() / "small_dog_%04d.qraw";
+    ASSERT_EQ(dog_seq.render(raw_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(dog_seq.get_output_path(), raw_output_path);
+
+    Quest::ImageSeq raw_seq;
+    ASSERT_EQ(raw_seq.open(raw_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(raw_seq.get_frame_count(), 187);
+    ASSERT_EQ(raw_seq.get_width(), 1080);
+    ASSERT_EQ(raw_seq.get_height(), 1920);
+    ASSERT_EQ(raw_seq, dog_seq);
+
+    // Frames are mapped privately, so editing them in memory must not change the files on disk
+    GaussianBlur(raw_seq[5], raw_seq[5], cv::Size(15, 15), 0, 0, cv::BORDER_CONSTANT);
+    Quest::ImageSeq raw_seq_reopened;
+    raw_seq_reopened.open(raw_output_path);
+    ASSERT_EQ(raw_seq_reopened, dog_seq);
+
+    // A frame shared out of the sequence keeps its mapping alive after the sequence is gone
+    cv::Mat shared_frame;
+    {
+        Quest::ImageSeq scoped_seq;
+        scoped_seq.open(raw_output_path);
+        shared_frame = scoped_seq[20];
+    }
+    ASSERT_TRUE(Quest::MatEquals(shared_frame, dog_seq[20]));
+}
+
+TEST_F(ImageSeqLibTest, TestImageSeqOpenRawFrameBadFile) {
+    Quest::ImageSeq seq;
+    ASSERT_EQ(seq.open("badpath/frame.qraw"), Quest::SeqErrorCodes::BadPath);
+    ASSERT_EQ(seq.open(house_picture_path.parent_path() / "missing_%04d.qraw"), Quest::SeqErrorCodes::BadPath);
+    ASSERT_TRUE(Quest::ReadRawFrame(house_picture_path).empty());
+
+    // A header whose type has been corrupted is rejected rather than handed to OpenCV
+    const std::filesystem::path raw_path = video_output_path.parent_path() / "corrupted.qraw";
+    ASSERT_TRUE(Quest::WriteRawFrame(raw_path, dog_seq[0]));
+    ASSERT_FALSE(Quest::ReadRawFrame(raw_path).empty());
+    for (const int32_t type : {-1, CV_MAKETYPE(CV_8U, 5), CV_8UC4 | (1 << 12), std::numeric_limits<int32_t>::max()}) {
+        std::fstream file(raw_path, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(offsetof(Quest::RawFrameHeader, type));
+        file.write(reinterpret_cast<const char*>(&type), sizeof(type));
+        file.close();
+        ASSERT_TRUE(Quest::ReadRawFrame(raw_path).empty());
+        ASSERT_EQ(seq.open(raw_path), Quest::SeqErrorCodes::BadPath);
+    }
+}
+
+// Single file container round trips, raw and with each frame encoded
+TEST_F(ImageSeqLibTest, TestImageSeqRenderAndOpenContainer) {
+    const std::filesystem::path container_path = video_output_path.parent_path() / "small_dog.qseq";
+    ASSERT_EQ(dog_seq.render(container_path), Quest::SeqErrorCodes::Success);
+    Quest::ImageSeq raw_container_seq;
+    ASSERT_EQ(raw_container_seq.open(container_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(raw_container_seq.get_frame_count(), 187);
+    ASSERT_EQ(raw_container_seq, dog_seq);
+
+    Quest::RenderOptions options;
+    options.container_codec = ".png";
+    options.png_compression = 1;
+    ASSERT_EQ(dog_seq.render(container_path, options), Quest::SeqErrorCodes::Success);
+    Quest::ImageSeq png_container_seq;
+    ASSERT_EQ(png_container_seq.open(container_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(png_container_seq, dog_seq);
+
+    // Random access to a single frame without opening the whole sequence
+    Quest::SeqContainer container;
+    ASSERT_EQ(container.open(container_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(container.get_frame_count(), 187);
+    ASSERT_TRUE(Quest::MatEquals(container.read_frame(150), dog_seq[150]));
+    ASSERT_THROW(static_cast<void>(container.read_frame(187)), std::out_of_range);
+}
+
+TEST_F(ImageSeqLibTest, TestImageSeqContainerFailures) {
+    Quest::ImageSeq seq;
+    ASSERT_EQ(seq.open("badpath/sequence.qseq"), Quest::SeqErrorCodes::BadPath);
+
+    // Any file without a container footer is rejected
+    const std::filesystem::path not_a_container = video_output_path.parent_path() / "not_a_container.qseq";
+    std::filesystem::copy_file(house_picture_path, not_a_container);
+    ASSERT_EQ(seq.open(not_a_container), Quest::SeqErrorCodes::BadPath);
+
+    Quest::RenderOptions options;
+    options.container_codec = ".obj";
+    ASSERT_THROW(dog_seq.render(not_a_container, options), Quest::SeqException);
+}
+
+// DPX round trip. Frames are written as 10 bit RGBA and read back widened to 16 bit, so scaling them back down to
+// 8 bit must give the original frames, alpha included
+TEST_F(ImageSeqLibTest, TestImageSeqRenderAndOpenDpxSequence) {
+    const std::filesystem::path dpx_output_path = video_output_path.parent_path() / "small_dog_%04d.dpx";
+    ASSERT_EQ(dog_seq.render(dpx_output_path), Quest::SeqErrorCodes::Success);
+
+    Quest::ImageSeq dpx_seq;
+    ASSERT_EQ(dpx_seq.open(dpx_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(dpx_seq.get_frame_count(), 187);
+    ASSERT_EQ(dpx_seq.get_width(), 1080);
+    ASSERT_EQ(dpx_seq.get_height(), 1920);
+    for (int i = 0; i < dpx_seq.get_frame_count(); i++) {
+        ASSERT_EQ(dpx_seq[i].type(), CV_16UC4);
+        cv::Mat eight_bit;
+        dpx_seq[i].convertTo(eight_bit, CV_8U, 1.0 / 257);
+        ASSERT_TRUE(Quest::MatEquals(eight_bit, dog_seq[i]));
+    }
+
+    // 10 bit data widened to 16 bit survives another trip through DPX unchanged
+    const std::filesystem::path dpx_rerender_path = video_output_path.parent_path() / "small_dog_rerender_%04d.dpx";
+    ASSERT_EQ(dpx_seq.render(dpx_rerender_path), Quest::SeqErrorCodes::Success);
+    Quest::ImageSeq dpx_rerendered_seq;
+    ASSERT_EQ(dpx_rerendered_seq.open(dpx_rerender_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(dpx_rerendered_seq, dpx_seq);
+}
+
+TEST_F(ImageSeqLibTest, TestImageSeqOpenDpxBadFile) {
+    Quest::ImageSeq seq;
+    ASSERT_EQ(seq.open("badpath/frame.dpx"), Quest::SeqErrorCodes::BadPath);
+    ASSERT_TRUE(Quest::ReadDpxFrame(house_picture_path).empty());
+    const std::filesystem::path two_channel_path = video_output_path.parent_path() / "two_channel.dpx";
+    ASSERT_FALSE(Quest::WriteDpxFrame(two_channel_path, cv::Mat(4, 4, CV_8UC2, cv::Scalar(1, 2))));
+}
+
+// Single channel frames are written as DPX luma and open with one channel, with an odd width so the last word of
+// each line is only partly filled
+TEST_F(ImageSeqLibTest, TestImageSeqRenderAndOpenDpxLuma) {
+    cv::Mat luma(9, 7, CV_8UC1);
+    for (int y = 0; y < luma.rows; y++) {
+        for (int x = 0; x < luma.cols; x++) luma.at<uchar>(y, x) = static_cast<uchar>(y * 31 + x * 7);
+    }
+    const std::filesystem::path luma_path = video_output_path.parent_path() / "luma.dpx";
+    ASSERT_TRUE(Quest::WriteDpxFrame(luma_path, luma));
+
+    const cv::Mat read = Quest::ReadDpxFrame(luma_path);
+    ASSERT_EQ(read.type(), CV_16UC1);
+    cv::Mat eight_bit;
+    read.convertTo(eight_bit, CV_8U, 1.0 / 257);
+    ASSERT_TRUE(Quest::MatEquals(eight_bit, luma));
+}
+
+// EXR frames open at float depth with their own channels rather than being forced to 8 bit with a new alpha
+TEST_F(ImageSeqLibTest, TestImageSeqRenderAndOpenExrSequence) {
+    const std::filesystem::path exr_output_path = video_output_path.parent_path() / "small_dog_%04d.exr";
+    Quest::RenderOptions options;
+    options.exr_type = cv::IMWRITE_EXR_TYPE_HALF;
+    ASSERT_EQ(dog_seq.render(exr_output_path, options), Quest::SeqErrorCodes::Success);
+
+    Quest::ImageSeq exr_seq;
+    ASSERT_EQ(exr_seq.open(exr_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(exr_seq.get_frame_count(), 187);
+    ASSERT_EQ(exr_seq.get_width(), 1080);
+    ASSERT_EQ(exr_seq.get_height(), 1920);
+    for (int i = 0; i < exr_seq.get_frame_count(); i++) {
+        ASSERT_EQ(exr_seq[i].depth(), CV_32F);
+        ASSERT_EQ(exr_seq[i].channels(), 4);
+        cv::Mat eight_bit;
+        exr_seq[i].convertTo(eight_bit, CV_8U, 255);
+        ASSERT_TRUE(Quest::MatEquals(eight_bit, dog_seq[i]));
+    }
+}
+
+// Grayscale files stay single channel and a real alpha isn't replaced by a white one
+TEST_F(ImageSeqLibTest, TestImageSeqOpenKeepsChannels) {
+    const std::filesystem::path gray_path = video_output_path.parent_path() / "gray.png";
+    const cv::Mat gray(4, 4, CV_8UC1, cv::Scalar(90));
+    ASSERT_TRUE(cv::imwrite(gray_path, gray));
+    Quest::ImageSeq gray_seq;
+    ASSERT_EQ(gray_seq.open(gray_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(gray_seq[0].type(), CV_8UC1);
+    ASSERT_TRUE(Quest::MatEquals(gray_seq[0], gray));
+
+    const std::filesystem::path alpha_path = video_output_path.parent_path() / "alpha.png";
+    const cv::Mat translucent(4, 4, CV_8UC4, cv::Scalar(10, 20, 30, 128));
+    ASSERT_TRUE(cv::imwrite(alpha_path, translucent));
+    Quest::ImageSeq alpha_seq;
+    ASSERT_EQ(alpha_seq.open(alpha_path), Quest::SeqErrorCodes::Success);
+    ASSERT_TRUE(Quest::MatEquals(alpha_seq[0], translucent));
+
+    std::vector<std::vector<uchar>> buffers(1);
+    ASSERT_TRUE(cv::imencode(".png", gray, buffers[0]));
+    Quest::ImageSeq decoded_seq;
+    ASSERT_EQ(decoded_seq.open(buffers), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(decoded_seq[0].type(), CV_8UC1);
+}
+
+// Files read whole into each thread's reused buffer decode to what cv::imread gives, including once a much bigger file
+// has been read on the same threads
+TEST_F(ImageSeqLibTest, TestImageSeqReadMatchesImread) {
+    // Files without alpha are read upright and get a white one
+    const auto expected = [](const std::filesystem::path& path) {
+        cv::Mat image = cv::imread(path, cv::IMREAD_UNCHANGED);
+        if (image.channels() == 4) return image;
+        image = cv::imread(path, cv::IMREAD_ANYDEPTH | cv::IMREAD_ANYCOLOR);
+        if (image.channels() == 3) Quest::GiveMatPureWhiteAlpha(image);
+        return image;
+    };
+    Quest::ImageSeq house_seq;
+    ASSERT_EQ(house_seq.open(house_picture_path), Quest::SeqErrorCodes::Success);
+    ASSERT_TRUE(Quest::MatEquals(house_seq[0], expected(house_picture_path)));
+
+    Quest::ImageSeq read_seq;
+    ASSERT_EQ(read_seq.open(small_dog_seq_path), Quest::SeqErrorCodes::Success);
+    Quest::SeqPath frame_path(small_dog_seq_path);
+    for (const cv::Mat& frame : read_seq) ASSERT_TRUE(Quest::MatEquals(frame, expected(frame_path.outputIncrement())));
+}
+
+// JPEGs are turned upright by their EXIF orientation like cv::imread does
+TEST_F(ImageSeqLibTest, TestImageSeqOpenAppliesExifOrientation) {
+    const cv::Mat wide(8, 16, CV_8UC3, cv::Scalar(40, 80, 160));
+    std::vector<uchar> jpeg;
+    ASSERT_TRUE(cv::imencode(".jpg", wide, jpeg));
+    // APP1 segment with a big endian TIFF header and one IFD entry, orientation 6 (rotate 90 degrees clockwise)
+    const std::vector<uchar> exif = {
+        0xFF, 0xE1, 0x00, 0x22, 'E', 'x', 'i', 'f', 0, 0,
+        'M', 'M', 0x00, 0x2A, 0x00, 0x00, 0x00, 0x08,
+        0x00, 0x01, 0x01, 0x12, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00, 0x06, 0x00, 0x00,
+        0x00, 0x00, 0x00, 0x00};
+    jpeg.insert(jpeg.begin() + 2, exif.begin(), exif.end());
+    const std::filesystem::path rotated_path = video_output_path.parent_path() / "rotated.jpg";
+    std::ofstream(rotated_path, std::ios::binary).write(reinterpret_cast<const char*>(jpeg.data()),
+        static_cast<std::streamsize>(jpeg.size()));
+
+    Quest::ImageSeq rotated_seq;
+    ASSERT_EQ(rotated_seq.open(rotated_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(rotated_seq[0].size(), cv::imread(rotated_path).size());
+    ASSERT_EQ(rotated_seq[0].size(), cv::Size(wide.rows, wide.cols));
+}
+
+// Sequences numbered from 0000 open from their first frame
+TEST_F(ImageSeqLibTest, TestImageSeqOpenZeroNumberedSequence) {
+    const std::filesystem::path zero_path = video_output_path.parent_path() / "zero_%04d.png";
+    Quest::SeqPath zero_seq_path(zero_path, 0);
+    for (int i = 0; i < 3; i++) ASSERT_TRUE(cv::imwrite(zero_seq_path.outputIncrement(), dog_seq[i]));
+
+    Quest::ImageSeq zero_seq;
+    ASSERT_EQ(zero_seq.open(zero_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(zero_seq.get_frame_count(), 3);
+    for (int i = 0; i < 3; i++) ASSERT_TRUE(Quest::MatEquals(zero_seq[i], dog_seq[i]));
+}
+
+// 16 bit frames flow through open, render, equality and proxies without being converted to 8 bit
+TEST_F(ImageSeqLibTest, TestImageSeqSixteenBitSequence) {
+    for (cv::Mat& frame : dog_seq) {
+        frame.convertTo(frame, CV_16U, 257);
+    }
+    const std::filesystem::path sixteen_bit_path = video_output_path.parent_path() / "small_dog_16_%04d.png";
+    ASSERT_EQ(dog_seq.render(sixteen_bit_path), Quest::SeqErrorCodes::Success);
+
+    Quest::ImageSeq sixteen_bit_seq;
+    ASSERT_EQ(sixteen_bit_seq.open(sixteen_bit_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(sixteen_bit_seq[0].type(), CV_16UC4);
+    ASSERT_EQ(sixteen_bit_seq, dog_seq);
+
+    const Quest::Proxy sixteen_bit_proxy(sixteen_bit_seq);
+    ASSERT_EQ(sixteen_bit_proxy[0].type(), CV_16UC4);
+    ASSERT_EQ(sixteen_bit_proxy.get_width(), 540);
+
+    // JPEG can only store 8 bit, so frames are scaled down rather than truncated
+    const std::filesystem::path jpeg_path = video_output_path.parent_path() / "small_dog_16.jpg";
+    Quest::ImageSeq single_frame;
+    single_frame.open(sixteen_bit_path.parent_path() / "small_dog_16_0001.png");
+    ASSERT_EQ(single_frame.render(jpeg_path), Quest::SeqErrorCodes::Success);
+    const cv::Mat jpeg_frame = cv::imread(jpeg_path);
+    ASSERT_GT(cv::sum(jpeg_frame)[0], 0);
+}
+
 TEST_F(ImageSeqLibTest, TestImageSeqIterators) {
     // Test const iterators
     for (const cv::Mat& frame : dog_seq) {
@@ -411,20 +940,35 @@ TEST_F(ImageSeqLibTest, TestImageSeqHandlesUnsupportedImageExtensions) {
     ASSERT_EQ(unsupported_seq.open(dandelion_unsupported_path), Quest::SeqErrorCodes::UnsupportedExtension);
 }
 
-TEST_F(ImageSeqLibTest, TestMatEqualityFunctionWrongType) {
+TEST_F(ImageSeqLibTest, TestMatEqualityFunctionOtherDepths) {
     cv::Mat img = cv::imread("../../media/test_media/images/house_roof.jpg");
     cv::Mat img_eql = cv::imread("../../media/test_media/images/house_roof.jpg");
 
     img.convertTo(img, CV_32F);
 
-    ASSERT_THROW(Quest::MatEquals(img, img_eql), Quest::SeqException);
-    ASSERT_THROW(Quest::MatNotEquals(img, img_eql), Quest::SeqException);
-
-    ASSERT_THROW(Quest::MatEquals(img_eql, img), Quest::SeqException);
-    ASSERT_THROW(Quest::MatNotEquals(img_eql, img), Quest::SeqException);
-
-    ASSERT_THROW(Quest::MatEquals(img, img), Quest::SeqException);
-    ASSERT_THROW(Quest::MatNotEquals(img, img), Quest::SeqException);
+    // Mats of different depths are never equal
+    ASSERT_FALSE(Quest::MatEquals(img, img_eql));
+    ASSERT_TRUE(Quest::MatNotEquals(img, img_eql));
+    ASSERT_FALSE(Quest::MatEquals(img_eql, img));
+    ASSERT_TRUE(Quest::MatNotEquals(img_eql, img));
+
+    // Float and 16 bit Mats compare the same way as 8 bit ones
+    ASSERT_TRUE(Quest::MatEquals(img, img));
+    cv::Mat img_float_eql = img.clone();
+    ASSERT_TRUE(Quest::MatEquals(img, img_float_eql));
+    img_float_eql.at<cv::Vec3f>(100, 100)[1] += 0.5f;
+    ASSERT_FALSE(Quest::MatEquals(img, img_float_eql));
+
+    cv::Mat img_16, img_16_eql;
+    img_eql.convertTo(img_16, CV_16U, 257);
+    img_eql.convertTo(img_16_eql, CV_16U, 257);
+    ASSERT_TRUE(Quest::MatEquals(img_16, img_16_eql));
+    img_16_eql.at<cv::Vec3w>(10, 10)[2] -= 1;
+    ASSERT_FALSE(Quest::MatEquals(img_16, img_16_eql));
+
+    // Non continuous Mats (regions of a larger Mat) compare row by row
+    const cv::Rect region(10, 10, 200, 100);
+    ASSERT_TRUE(Quest::MatEquals(img_eql(region), img_eql(region).clone()));
 }
 
 TEST_F(ImageSeqLibTest, TestMatEqualityFunctionNoAlphaImage) {
@@ -526,6 +1070,63 @@ TEST_F(ImageSeqLibTest, TestImageSeqAssignmentOperator) {
     ASSERT_EQ(dog_seq.get_output_path(), wave_seq.get_output_path());
 }
 
+// Progress, Cancellation and Async Tests
+TEST_F(ImageSeqLibTest, TestImageSeqOpenProgressAndCancel) {
+    Quest::ImageSeq seq;
+    int calls = 0;
+    int last_done = 0;
+    int last_total = 0;
+    ASSERT_EQ(seq.open(wave_path, [&](const int done, const int total) {
+        calls++;
+        last_done = done;
+        last_total = total;
+    }), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(calls, seq.get_frame_count());
+    ASSERT_EQ(last_done, seq.get_frame_count());
+    ASSERT_EQ(last_total, seq.get_frame_count());
+
+    // Cancelling part way leaves the sequence as it was
+    const Quest::CancelToken cancel;
+    ASSERT_EQ(seq.open(small_dog_seq_path, [&](const int done, int) { if (done == 10) cancel.cancel(); }, cancel),
+        Quest::SeqErrorCodes::Cancelled);
+    ASSERT_EQ(seq, wave_seq);
+    ASSERT_EQ(seq.get_input_path(), wave_path);
+    ASSERT_EQ(seq.render(small_dog_output_path, Quest::RenderOptions(), nullptr, cancel),
+        Quest::SeqErrorCodes::Cancelled);
+}
+
+TEST_F(ImageSeqLibTest, TestImageSeqAsync) {
+    Quest::ImageSeq seq;
+    std::future<Quest::SeqErrorCodes> opened = seq.open_async(small_dog_seq_path);
+    ASSERT_EQ(opened.get(), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(seq, dog_seq);
+
+    std::atomic<int> rendered_frames = 0;
+    std::future<Quest::SeqErrorCodes> rendered = seq.render_async(small_dog_output_path, Quest::RenderOptions(),
+        [&](const int done, int) { rendered_frames = done; });
+    ASSERT_EQ(rendered.get(), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(rendered_frames, seq.get_frame_count());
+    ASSERT_EQ(seq.get_output_path(), small_dog_output_path);
+}
+
+// In-Memory IO Tests
+TEST_F(ImageSeqLibTest, TestImageSeqEncodedRoundTrip) {
+    std::vector<std::vector<uchar>> encoded_frames;
+    ASSERT_EQ(dog_seq.render(encoded_frames, ".png"), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(static_cast<int>(encoded_frames.size()), dog_seq.get_frame_count());
+
+    Quest::ImageSeq seq;
+    ASSERT_EQ(seq.open(encoded_frames), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(seq, dog_seq);
+    ASSERT_TRUE(seq.get_input_path().empty());
+
+    ASSERT_EQ(dog_seq.render(encoded_frames, ".mov"), Quest::SeqErrorCodes::UnsupportedExtension);
+    ASSERT_EQ(static_cast<int>(encoded_frames.size()), dog_seq.get_frame_count());
+    encoded_frames.back().resize(8);
+    ASSERT_EQ(seq.open(encoded_frames), Quest::SeqErrorCodes::BadPath);
+    ASSERT_EQ(seq, dog_seq);
+}
+
 // --- SeqPath Tests ---
 TEST_F(ImageSeqLibTest, TestSeqPathoutputPath) {
     ASSERT_EQ(test_seq->outputPath(), "small_dog_0001.png");
@@ -595,6 +1196,313 @@ TEST_F(ImageSeqLibTest, TestSeqPathoutputIncrement) {
     }
 }
 
+TEST_F(ImageSeqLibTest, TestForEachParallel) {
+    Quest::ImageSeq serial = dog_seq;
+    for (cv::Mat& frame : serial) {
+        GaussianBlur(frame, frame, cv::Size(25, 25), 0, 0, cv::BORDER_CONSTANT);
+    }
+    Quest::ImageSeq parallel = dog_seq;
+    parallel.for_each_parallel([](cv::Mat& frame) {
+        GaussianBlur(frame, frame, cv::Size(25, 25), 0, 0, cv::BORDER_CONSTANT);
+    });
+    ASSERT_EQ(parallel, serial);
+
+    Quest::ImageSeq compressed = dog_seq;
+    compressed.set_storage(Quest::FrameStorage::Compressed);
+    compressed.for_each_parallel([](cv::Mat& frame) {
+        GaussianBlur(frame, frame, cv::Size(25, 25), 0, 0, cv::BORDER_CONSTANT);
+    }, 2);
+    ASSERT_EQ(compressed, serial);
+}
+
+TEST_F(ImageSeqLibTest, TestTransformParallel) {
+    const Quest::ImageSeq halved = dog_seq.transform_parallel([](const cv::Mat& frame) {
+        cv::Mat resized;
+        cv::resize(frame, resized, cv::Size(), 0.5, 0.5);
+        return resized;
+    }, 3);
+    ASSERT_EQ(halved.get_frame_count(), dog_seq.get_frame_count());
+    ASSERT_EQ(halved.get_width(), dog_seq[0].cols / 2);
+    ASSERT_EQ(halved.get_fps(), dog_seq.get_fps());
+    for (int i = 0; i < dog_seq.get_frame_count(); i += 37) {
+        cv::Mat expected;
+        cv::resize(dog_seq[i], expected, cv::Size(), 0.5, 0.5);
+        ASSERT_TRUE(Quest::MatEquals(halved[i], expected));
+    }
+    ASSERT_THROW(static_cast<void>(dog_seq.transform_parallel([](const cv::Mat&) -> cv::Mat {
+        throw Quest::SeqException("Failed");
+    })), Quest::SeqException);
+}
+
+// SeqView Tests
+TEST_F(ImageSeqLibTest, TestSeqViewSliceStrideReverse) {
+    const Quest::SeqView whole(dog_seq);
+    ASSERT_EQ(whole, Quest::SeqView(dog_seq_identical));
+    ASSERT_EQ(whole.get_frame_count(), 187);
+
+    // Views share the sequence's frames
+    const Quest::SeqView middle = whole.slice(100, 150);
+    ASSERT_EQ(middle.get_frame_count(), 50);
+    ASSERT_EQ(middle[0].data, dog_seq[100].data);
+
+    const Quest::SeqView every_third = middle.stride(3);
+    ASSERT_EQ(every_third.get_frame_count(), 17);
+    ASSERT_EQ(every_third[16].data, dog_seq[148].data);
+
+    const Quest::SeqView backwards = every_third.reversed();
+    ASSERT_EQ(backwards.get_frame_count(), 17);
+    ASSERT_EQ(backwards[0].data, dog_seq[148].data);
+    ASSERT_EQ(backwards.reversed(), every_third);
+    ASSERT_NE(backwards, every_third);
+
+    int i = 100;
+    for (const cv::Mat& frame : middle) {
+        ASSERT_EQ(frame.data, dog_seq[i++].data);
+    }
+
+    ASSERT_THROW(static_cast<void>(whole.slice(150, 200)), std::out_of_range);
+    ASSERT_THROW(static_cast<void>(whole.stride(0)), Quest::SeqException);
+    ASSERT_THROW(static_cast<void>(middle[50]), std::out_of_range);
+}
+
+TEST_F(ImageSeqLibTest, TestSeqViewRenderAndProxy) {
+    const Quest::SeqView middle = Quest::SeqView(dog_seq).slice(100, 150).reversed();
+    ASSERT_EQ(middle.render(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    Quest::ImageSeq rendered;
+    ASSERT_EQ(rendered.open(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(rendered, middle);
+
+    const Quest::Proxy view_proxy(middle);
+    const Quest::Proxy whole_proxy(dog_seq);
+    ASSERT_EQ(view_proxy.get_frame_count(), 50);
+    ASSERT_EQ(view_proxy, Quest::SeqView(whole_proxy).slice(100, 150).reversed());
+}
+
+// Timeline Tests
+TEST_F(ImageSeqLibTest, TestTimelineConcatenatesShots) {
+    Quest::Timeline reel;
+    reel.set_max_open_shots(1);
+    reel.append(Quest::SeqView(dog_seq).slice(0, 10));
+    ASSERT_EQ(reel.append(wave_path), Quest::SeqErrorCodes::Success);
+    reel.append(Quest::SeqView(dog_seq).slice(0, 10).reversed());
+    ASSERT_EQ(reel.append(small_dog_seq_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(reel.append(bad_small_dog_seq_path), Quest::SeqErrorCodes::BadPath);
+    ASSERT_EQ(reel.append(dandelion_unsupported_path), Quest::SeqErrorCodes::UnsupportedExtension);
+
+    const int wave_frames = wave_seq.get_frame_count();
+    ASSERT_EQ(reel.get_shot_count(), 4);
+    ASSERT_EQ(reel.get_frame_count(), 20 + wave_frames + dog_seq.get_frame_count());
+
+    // View shots share their sequence's frames, path shots are opened as they're reached
+    ASSERT_EQ(reel[0].data, dog_seq[0].data);
+    ASSERT_TRUE(Quest::MatEquals(reel[10], wave_seq[0]));
+    ASSERT_EQ(reel[10 + wave_frames].data, dog_seq[9].data);
+    ASSERT_TRUE(Quest::MatEquals(reel[20 + wave_frames], dog_seq[0]));
+    ASSERT_TRUE(Quest::MatEquals(reel.get_frame(10 + wave_frames - 1), wave_seq[wave_frames - 1]));
+
+    int i = 0;
+    for (const cv::Mat& frame : reel) {
+        ASSERT_FALSE(frame.empty());
+        i++;
+    }
+    ASSERT_EQ(i, reel.get_frame_count());
+    ASSERT_THROW(static_cast<void>(reel[reel.get_frame_count()]), std::out_of_range);
+}
+
+// A path shot that loses frames after it's appended fails loudly instead of giving empty frames
+TEST_F(ImageSeqLibTest, TestTimelineShotShorterThanAppended) {
+    const std::filesystem::path shot_path = video_output_path.parent_path() / "short_shot_%04d.png";
+    ASSERT_EQ(Quest::SeqView(dog_seq).slice(0, 5).render(shot_path), Quest::SeqErrorCodes::Success);
+    Quest::Timeline reel;
+    ASSERT_EQ(reel.append(shot_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(reel.get_frame_count(), 5);
+
+    std::filesystem::path last_frame;
+    for (const auto& entry : std::filesystem::directory_iterator(shot_path.parent_path())) {
+        const std::string name = entry.path().filename().string();
+        if (name.starts_with("short_shot_") && (last_frame.empty() || entry.path() > last_frame)) {
+            last_frame = entry.path();
+        }
+    }
+    ASSERT_TRUE(std::filesystem::remove(last_frame));
+    ASSERT_THROW(static_cast<void>(reel.get_frame(0)), Quest::SeqException);
+}
+
+TEST_F(ImageSeqLibTest, TestTimelineRender) {
+    Quest::Timeline reel;
+    reel.append(Quest::SeqView(dog_seq).slice(150, 187));
+    reel.append(Quest::SeqView(dog_blurred).slice(0, 20));
+    ASSERT_EQ(reel.render(small_dog_output_path), Quest::SeqErrorCodes::Success);
+
+    Quest::ImageSeq rendered;
+    ASSERT_EQ(rendered.open(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(rendered.get_frame_count(), 57);
+    ASSERT_EQ(Quest::SeqView(rendered).slice(0, 37), Quest::SeqView(dog_seq).slice(150, 187));
+    ASSERT_EQ(Quest::SeqView(rendered).slice(37, 57), Quest::SeqView(dog_blurred).slice(0, 20));
+}
+
+// FrameRange Tests
+static_assert(std::ranges::random_access_range<Quest::FrameRange>);
+static_assert(std::ranges::random_access_range<Quest::ImageSeq>);
+
+TEST_F(ImageSeqLibTest, TestFrameRangePipeline) {
+    const auto grade = [](const cv::Mat& frame) {
+        cv::Mat graded;
+        GaussianBlur(frame, graded, cv::Size(5, 5), 0, 0, cv::BORDER_CONSTANT);
+        Quest::GiveMatAlpha(graded, 123);
+        return graded;
+    };
+    const Quest::FrameRange range = dog_seq | Quest::views::frames_between(100, 150) | Quest::views::transform(grade)
+        | Quest::views::stride(2);
+    ASSERT_EQ(range.get_frame_count(), 25);
+    ASSERT_EQ(range.get_fps(), dog_seq.get_fps());
+
+    int i = 0;
+    for (const cv::Mat& frame : range) {
+        ASSERT_TRUE(Quest::MatEquals(frame, grade(dog_seq[100 + i * 2])));
+        i++;
+    }
+    ASSERT_EQ(i, 25);
+
+    const Quest::FrameRange backwards = Quest::SeqView(dog_seq).slice(0, 10) | Quest::views::reverse;
+    ASSERT_TRUE(Quest::MatEquals(backwards[0], dog_seq[9]));
+    ASSERT_TRUE(Quest::MatEquals(*std::ranges::next(backwards.begin(), 9), dog_seq[0]));
+
+    ASSERT_THROW(static_cast<void>(range[25]), std::out_of_range);
+    ASSERT_THROW(static_cast<void>(dog_seq | Quest::views::frames_between(150, 100)), std::out_of_range);
+    ASSERT_THROW(static_cast<void>(dog_seq | Quest::views::stride(0)), Quest::SeqException);
+}
+
+TEST_F(ImageSeqLibTest, TestFrameRangeRender) {
+    const Quest::FrameRange range = dog_seq | Quest::views::frames_between(50, 90) | Quest::views::stride(4);
+    ASSERT_EQ(range.render(small_dog_output_path), Quest::SeqErrorCodes::Success);
+
+    Quest::ImageSeq rendered;
+    ASSERT_EQ(rendered.open(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(rendered.get_frame_count(), 10);
+    ASSERT_EQ(Quest::SeqView(rendered), Quest::SeqView(dog_seq).slice(50, 90).stride(4));
+    ASSERT_THROW(static_cast<void>(Quest::FrameRange().render(small_dog_output_path)), Quest::SeqException);
+}
+
+// Stream Tests
+static_assert(std::ranges::input_range<Quest::FrameGenerator>);
+
+TEST_F(ImageSeqLibTest, TestStream) {
+    int i = 0;
+    for (const cv::Mat& frame : Quest::stream(small_dog_seq_path, 2)) {
+        ASSERT_TRUE(Quest::MatEquals(frame, dog_seq[i]));
+        i++;
+    }
+    ASSERT_EQ(i, dog_seq.get_frame_count());
+
+    i = 0;
+    for (const cv::Mat& frame : Quest::stream(video_file_path)) {
+        ASSERT_TRUE(Quest::MatEquals(frame, video_seq[i]));
+        if (++i == 10) break; // Leaving early stops the reader
+    }
+    ASSERT_EQ(i, 10);
+
+    const auto count_frames = [](const std::filesystem::path& path) {
+        int count = 0;
+        for (const cv::Mat& frame : Quest::stream(path)) {
+            static_cast<void>(frame);
+            count++;
+        }
+        return count;
+    };
+    ASSERT_EQ(count_frames(house_picture_path), 1);
+    ASSERT_THROW(static_cast<void>(count_frames(bad_small_dog_seq_path)), Quest::SeqException);
+    ASSERT_THROW(static_cast<void>(count_frames(dandelion_unsupported_path)), Quest::SeqException);
+}
+
+// Pipeline Tests
+TEST_F(ImageSeqLibTest, TestPipelineRun) {
+    const auto blur = [](const cv::Mat& frame) {
+        cv::Mat blurred;
+        GaussianBlur(frame, blurred, cv::Size(25, 25), 0, 0, cv::BORDER_CONSTANT);
+        return blurred;
+    };
+    const auto alpha = [](const cv::Mat& frame) {
+        cv::Mat with_alpha = frame.clone();
+        Quest::GiveMatAlpha(with_alpha, 123);
+        return with_alpha;
+    };
+    Quest::Pipeline pipeline(small_dog_seq_path, small_dog_output_path);
+    pipeline.add_stage(blur, "blur", 3).add_stage(alpha);
+    ASSERT_EQ(pipeline.run(), Quest::SeqErrorCodes::Success);
+
+    Quest::ImageSeq rendered;
+    ASSERT_EQ(rendered.open(small_dog_output_path), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(rendered, dog_seq.transform_parallel([&](const cv::Mat& frame) { return alpha(blur(frame)); }));
+
+    const std::vector<Quest::Pipeline::StageStats>& stats = pipeline.get_stats();
+    ASSERT_EQ(stats.size(), 3u);
+    ASSERT_EQ(stats[0].name, "source");
+    ASSERT_EQ(stats[1].name, "blur");
+    ASSERT_EQ(stats[1].threads, 3);
+    ASSERT_EQ(stats[2].name, "stage 2");
+    for (const Quest::Pipeline::StageStats& stage : stats) {
+        ASSERT_EQ(stage.frames, dog_seq.get_frame_count());
+        ASSERT_GT(stage.get_frames_per_second(), 0);
+    }
+}
+
+TEST_F(ImageSeqLibTest, TestPipelineThreadCap) {
+    const auto identity = [](const cv::Mat& frame) { return frame; };
+    Quest::Pipeline pipeline(small_dog_seq_path, small_dog_output_path);
+    pipeline.add_stage(identity, "wide", 3).add_stage(identity, "narrow", 1);
+    Quest::ThreadPool::set_max_threads(2);
+    ASSERT_EQ(pipeline.run(), Quest::SeqErrorCodes::Success);
+    ASSERT_EQ(pipeline.get_stats()[1].threads, 1);
+    ASSERT_EQ(pipeline.get_stats()[2].threads, 1);
+}
+
+TEST_F(ImageSeqLibTest, TestPipelineLiveThreadsWithinCap) {
+    const std::filesystem::path tasks = "/proc/self/task";
+    if (!std::filesystem::is_directory(tasks)) GTEST_SKIP() << "Live threads can only be counted through /proc";
+    const auto live_threads = [&] {
+        return static_cast<int>(std::distance(std::filesystem::directory_iterator(tasks),
+            std::filesystem::directory_iterator()));
+    };
+
+    const int max_threads = 3;
+    Quest::ThreadPool::set_max_threads(max_threads);
+    // The calling thread counts as one of the global pool's, so everything else running isn't the library's
+    const int other_threads = live_threads() - (Quest::ThreadPool::global().get_thread_count() - 1);
+    std::atomic<int> peak_threads = 0;
+    const auto sample = [&](const cv::Mat& frame) {
+        int seen = peak_threads;
+        const int now = live_threads();
+        while (now > seen && !peak_threads.compare_exchange_weak(seen, now)) {}
+        return frame;
+    };
+    Quest::Pipeline pipeline(small_dog_seq_path, small_dog_output_path);
+    pipeline.add_stage(sample, "wide", 3).add_stage(sample, "middle", 2).add_stage(sample, "last", 1);
+    ASSERT_EQ(pipeline.run(), Quest::SeqErrorCodes::Success);
+
+    // The pool keeps the calling thread and the three stages share the other two, so the last two share one
+    ASSERT_LE(peak_threads, other_threads + max_threads - 1);
+    for (const Quest::Pipeline::StageStats& stage : pipeline.get_stats()) {
+        ASSERT_EQ(stage.frames, dog_seq.get_frame_count());
+    }
+    ASSERT_EQ(pipeline.get_stats()[1].threads, 1);
+    ASSERT_EQ(pipeline.get_stats()[3].threads, 1);
+    ASSERT_EQ(Quest::ThreadPool::global().get_thread_count(), Quest::ThreadPool(0).get_thread_count());
+}
+
+TEST_F(ImageSeqLibTest, TestPipelineErrors) {
+    ASSERT_EQ(Quest::Pipeline(bad_small_dog_seq_path, small_dog_output_path).run(), Quest::SeqErrorCodes::BadPath);
+    ASSERT_EQ(Quest::Pipeline(dandelion_unsupported_path, small_dog_output_path).run(),
+        Quest::SeqErrorCodes::UnsupportedExtension);
+
+    Quest::Pipeline failing(small_dog_seq_path, small_dog_output_path);
+    failing.add_stage([](const cv::Mat& frame) { return frame; }).add_stage([](const cv::Mat&) -> cv::Mat {
+        throw Quest::SeqException("Failed");
+    });
+    ASSERT_THROW(static_cast<void>(failing.run()), Quest::SeqException);
+    ASSERT_THROW(failing.add_stage(nullptr), Quest::SeqException);
+}
+
 // Proxy Tests
 TEST_F(ImageSeqLibTest, TestProxyConstructor) {
     Quest::Proxy dog_proxy(dog_seq);
@@ -614,6 +1522,16 @@ TEST_F(ImageSeqLibTest, TestProxyConstructor) {
     ASSERT_EQ(dog_proxy_actual, dog_proxy_expected);
 }
 
+TEST_F(ImageSeqLibTest, TestProxyWriteFrames) {
+    Quest::Proxy dog_proxy(dog_seq);
+    const cv::Mat black(dog_proxy.get_height(), dog_proxy.get_width(), dog_proxy[0].type(), cv::Scalar(0, 0, 0, 255));
+    dog_proxy.set_frame(1, black);
+    black.copyTo(dog_proxy[2]);
+    for (cv::Mat& frame : dog_proxy) frame.setTo(cv::Scalar(0, 0, 0, 255));
+    ASSERT_EQ(dog_proxy.get_dirty_frame_count(), dog_proxy.get_frame_count());
+    ASSERT_TRUE(Quest::MatEquals(dog_proxy.get_frame(1), black));
+}
+
 TEST_F(ImageSeqLibTest, TestProxyConstructorBadResizeValue) {
     ASSERT_THROW(Quest::Proxy dog_proxy(dog_seq, -0.1), Quest::SeqException);
     ASSERT_THROW(Quest::Proxy dog_proxy_2(dog_seq, 1.1), Quest::SeqException);
@@ -621,12 +1539,8 @@ TEST_F(ImageSeqLibTest, TestProxyConstructorBadResizeValue) {
 
 // Helper Method Tests
 TEST_F(ImageSeqLibTest, TestGiveMatAlphaWithBadMat) {
-    cv::Mat channels[4];
-    cv::split(new_frame, channels);
-    ASSERT_THROW(Quest::GiveMatAlpha(channels[2], 123), Quest::SeqException);
-
-    new_frame.convertTo(new_frame, CV_32F);
-    ASSERT_THROW(Quest::GiveMatAlpha(new_frame, 123), Quest::SeqException);
+    cv::Mat two_channels(cv::Size(100, 100), CV_8UC2, cv::Scalar(100, 100));
+    ASSERT_THROW(Quest::GiveMatAlpha(two_channels, 123), Quest::SeqException);
 
     cv::Mat zero_x_mat(cv::Size(0, 100), CV_8UC4, cv::Scalar(100, 100, 100, 100));
     cv::Mat zero_y_mat(cv::Size(100, 0), CV_8UC4, cv::Scalar(100, 100, 100, 100));
@@ -636,6 +1550,32 @@ TEST_F(ImageSeqLibTest, TestGiveMatAlphaWithBadMat) {
     ASSERT_THROW(Quest::GiveMatAlpha(zero_both_mat, 123), Quest::SeqException);
 }
 
+// Alpha values are given on the 8 bit scale and stretched to the Mat's own depth
+TEST_F(ImageSeqLibTest, TestGiveMatAlphaOtherDepthsAndChannels) {
+    cv::Mat channels[4];
+    cv::split(new_frame, channels);
+    cv::Mat gray = channels[2];
+    Quest::GiveMatPureWhiteAlpha(gray);
+    ASSERT_EQ(gray.type(), CV_8UC4);
+    cv::Mat gray_channels[4];
+    cv::split(gray, gray_channels);
+    ASSERT_TRUE(Quest::MatEquals(gray_channels[0], channels[2]));
+    ASSERT_TRUE(Quest::MatEquals(gray_channels[1], channels[2]));
+    ASSERT_EQ(cv::countNonZero(gray_channels[3] != 255), 0);
+
+    cv::Mat sixteen_bit;
+    new_frame.convertTo(sixteen_bit, CV_16U, 257);
+    Quest::GiveMatPureWhiteAlpha(sixteen_bit);
+    ASSERT_EQ(sixteen_bit.type(), CV_16UC4);
+    ASSERT_EQ(sixteen_bit.at<cv::Vec4w>(50, 50)[3], 65535);
+
+    cv::Mat float_frame;
+    new_frame.convertTo(float_frame, CV_32F, 1.0 / 255);
+    Quest::GiveMatAlpha(float_frame, 51);
+    ASSERT_EQ(float_frame.type(), CV_32FC4);
+    ASSERT_FLOAT_EQ(float_frame.at<cv::Vec4f>(50, 50)[3], 0.2f);
+}
+
 TEST_F(ImageSeqLibTest, TestGiveMatAlphaWithBadAlphaValue) {
     ASSERT_THROW(Quest::GiveMatAlpha(new_frame, -1), Quest::SeqException);
     ASSERT_THROW(Quest::GiveMatAlpha(new_frame, 256), Quest::SeqException);
@@ -714,4 +1654,123 @@ TEST_F(ImageSeqLibTest, TestHasFramePaddingHelperFunction) {
     ASSERT_TRUE(Quest::HasFramePadding("padding_%04d.png"));
     ASSERT_TRUE(Quest::HasFramePadding("folder/padding_%01d.tiff"));
     ASSERT_TRUE(Quest::HasFramePadding("folder/padding_%33d.png"));
-}
\ No newline at end of file
+}
+
+// --- FramePool Tests ---
+TEST_F(ImageSeqLibTest, TestFramePoolReusesBuffers) {
+    Quest::FramePool pool;
+    const uchar* first_data;
+    {
+        const cv::Mat frame = pool.acquire(720, 1280, CV_8UC4);
+        ASSERT_EQ(frame.rows, 720);
+        ASSERT_EQ(frame.cols, 1280);
+        ASSERT_EQ(frame.type(), CV_8UC4);
+        ASSERT_TRUE(frame.isContinuous());
+        first_data = frame.data;
+    }
+    ASSERT_EQ(pool.get_stats().cached_bytes, 720u * 1280 * 4);
+
+    // Same size and type gets the returned buffer back, anything else allocates
+    const cv::Mat reused = pool.acquire(720, 1280, CV_8UC4);
+    ASSERT_EQ(reused.data, first_data);
+    const cv::Mat other_type = pool.acquire(720, 1280, CV_16UC4);
+    ASSERT_EQ(pool.get_stats().hits, 1u);
+    ASSERT_EQ(pool.get_stats().misses, 2u);
+
+    // Nothing is cached past the limit
+    Quest::FramePool small_pool(1024);
+    { const cv::Mat frame = small_pool.acquire(720, 1280, CV_8UC4); }
+    ASSERT_EQ(small_pool.get_stats().cached_bytes, 0u);
+}
+
+// Once warmed up, adding alphas to a stream of frames shouldn't allocate anything new
+TEST_F(ImageSeqLibTest, TestFramePoolSteadyStateAlpha) {
+    Quest::FramePool& pool = Quest::FramePool::global();
+    for (int i = 0; i < 2; i++) {
+        cv::Mat frame = pool.acquire(new_frame.size(), new_frame.type());
+        new_frame.copyTo(frame);
+        Quest::GiveMatPureWhiteAlpha(frame);
+    }
+    pool.reset_stats();
+    for (int i = 0; i < 10; i++) {
+        cv::Mat frame = pool.acquire(new_frame.size(), new_frame.type());
+        new_frame.copyTo(frame);
+        Quest::GiveMatPureWhiteAlpha(frame);
+    }
+    ASSERT_EQ(pool.get_stats().misses, 0u);
+    ASSERT_EQ(pool.get_stats().hits, 30u);
+}
+
+// --- ThreadPool Tests ---
+TEST_F(ImageSeqLibTest, TestThreadPoolParallelFor) {
+    Quest::ThreadPool pool(4);
+    ASSERT_EQ(pool.get_thread_count(), 4);
+
+    // Nested loops run on the same workers and every index is visited exactly once
+    std::vector<std::atomic<int>> visits(64 * 16);
+    pool.parallel_for(64, [&](const int i) {
+        pool.parallel_for(16, [&](const int j) { visits[i * 16 + j]++; });
+    });
+    for (const std::atomic<int>& count : visits) ASSERT_EQ(count.load(), 1);
+
+    ASSERT_THROW(pool.parallel_for(100, [](const int i) {
+        if (i == 50) throw Quest::SeqException("Failed");
+    }), Quest::SeqException);
+}
+
+TEST_F(ImageSeqLibTest, TestThreadPoolSubmit) {
+    Quest::ThreadPool pool(3);
+    std::vector<std::future<int>> results;
+    for (int i = 0; i < 20; i++) {
+        results.push_back(pool.submit([i] { return i * i; }));
+    }
+    for (int i = 0; i < 20; i++) ASSERT_EQ(pool.wait(results[i]), i * i);
+    ASSERT_GE(pool.get_stats().tasks_run, 20u);
+
+    // A single thread pool has no workers and runs tasks on the caller
+    Quest::ThreadPool single(1);
+    std::future<std::thread::id> ran_on = single.submit([] { return std::this_thread::get_id(); });
+    ASSERT_EQ(single.wait(ran_on), std::this_thread::get_id());
+}
+
+TEST_F(ImageSeqLibTest, TestThreadPoolMaxThreads) {
+    Quest::ThreadPool::set_max_threads(2);
+    ASSERT_EQ(Quest::ThreadPool::get_max_threads(), 2);
+    ASSERT_LE(Quest::ThreadPool::global().get_thread_count(), 2);
+    ASSERT_EQ(Quest::ThreadPool(8).get_thread_count(), 2);
+    ASSERT_EQ(cv::getNumThreads(), 2);
+
+    // The library still works under the cap
+    Quest::ImageSeq copy = dog_seq;
+    ASSERT_EQ(copy, dog_seq);
+
+    Quest::ThreadPool::set_max_threads(0);
+    ASSERT_EQ(Quest::ThreadPool(8).get_thread_count(), 8);
+}
+
+TEST_F(ImageSeqLibTest, TestThreadPoolReservation) {
+    Quest::ThreadPool::set_max_threads(4);
+    {
+        // The global pool keeps one thread however much is asked for
+        const Quest::ThreadPool::Reservation reservation(8);
+        ASSERT_EQ(reservation.get_threads(), 3);
+        ASSERT_EQ(Quest::ThreadPool::global().get_thread_count(), 1);
+        ASSERT_EQ(Quest::ThreadPool(8).get_thread_count(), 1);
+
+        // Nothing is left, but a thread that's already running still gets counted
+        const Quest::ThreadPool::Reservation over(1);
+        ASSERT_EQ(over.get_threads(), 1);
+    }
+    ASSERT_EQ(Quest::ThreadPool::global().get_thread_count(), Quest::ThreadPool(0).get_thread_count());
+
+    // Streaming holds one for its reader thread
+    Quest::ThreadPool::set_max_threads(2);
+    int frames = 0;
+    for (const cv::Mat& frame : Quest::stream(small_dog_seq_path)) {
+        ASSERT_EQ(Quest::ThreadPool::global().get_thread_count(), 1);
+        ASSERT_FALSE(frame.empty());
+        frames++;
+    }
+    ASSERT_EQ(frames, dog_seq.get_frame_count());
+    ASSERT_EQ(Quest::ThreadPool::global().get_thread_count(), Quest::ThreadPool(0).get_thread_count());
+}
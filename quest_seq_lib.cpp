@@ -1,225 +1,3157 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <regex>
+#include <shared_mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 #include "quest_seq_lib.h"
 
-bool Quest::HasFramePadding(const std::filesystem::path& file_path) {
-    std::string path_string = file_path;
-    const std::regex padding_pattern(R"(%\d\dd)");
-    std::smatch matches, matches_2;
-    if (std::regex_search(path_string, matches, padding_pattern)) {
-        std::string suffix_string = matches.suffix();
-        if (std::regex_search(suffix_string, matches_2, padding_pattern)) {
+namespace {
+    // Lets a cv::Mat point into memory owned by something other than OpenCV (a file mapping, for example) while
+    // keeping that owner alive for as long as any Mat shares the data. Reallocations are handed to OpenCV's own
+    // allocator, which then owns and frees the new buffer itself
+    class SharedBufferAllocator : public cv::MatAllocator {
+    public:
+        cv::UMatData* allocate(const int dims, const int* sizes, const int type, void* data, size_t* step,
+            const cv::AccessFlag flags, const cv::UMatUsageFlags usage_flags) const override {
+            return cv::Mat::getStdAllocator()->allocate(dims, sizes, type, data, step, flags, usage_flags);
+        }
+
+        bool allocate(cv::UMatData* data, const cv::AccessFlag access_flags,
+            const cv::UMatUsageFlags usage_flags) const override {
+            return cv::Mat::getStdAllocator()->allocate(data, access_flags, usage_flags);
+        }
+
+        void deallocate(cv::UMatData* data) const override {
+            if (!data) return;
+            delete static_cast<std::shared_ptr<void>*>(data->userdata);
+            delete data;
+        }
+    };
+
+    // Never destroyed so Mats living in static storage can still release their buffers during shutdown
+    SharedBufferAllocator& GetSharedBufferAllocator() {
+        static auto* allocator = new SharedBufferAllocator();
+        return *allocator;
+    }
+
+    cv::Mat WrapSharedBuffer(const int rows, const int cols, const int type, void* data, const size_t step,
+        std::shared_ptr<void> owner) {
+        cv::Mat mat(rows, cols, type, data, step);
+        auto* mat_data = new cv::UMatData(&GetSharedBufferAllocator());
+        mat_data->data = mat_data->origdata = static_cast<uchar*>(data);
+        mat_data->size = step * rows;
+        mat_data->refcount = 1;
+        mat_data->userdata = new std::shared_ptr<void>(std::move(owner));
+        mat.u = mat_data;
+        mat.allocator = &GetSharedBufferAllocator();
+        return mat;
+    }
+
+    // Private, writable mapping of a whole file. Writes land in copy on write pages and never reach the file
+    struct MappedFile {
+        void* address = MAP_FAILED;
+        size_t length = 0;
+
+        explicit MappedFile(const std::filesystem::path& file_path) {
+            const int fd = ::open(file_path.c_str(), O_RDONLY);
+            if (fd < 0) return;
+            struct stat file_stat {};
+            if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+                length = static_cast<size_t>(file_stat.st_size);
+                address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            }
+            ::close(fd);
+            if (address != MAP_FAILED) madvise(address, length, MADV_WILLNEED);
+        }
+
+        // Map length bytes of an already open file from a page aligned offset
+        MappedFile(const int fd, const off_t offset, const size_t new_length) : length(new_length) {
+            if (length > 0) address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, offset);
+        }
+
+        ~MappedFile() {
+            if (address != MAP_FAILED) munmap(address, length);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        [[nodiscard]] bool valid() const { return address != MAP_FAILED; }
+        [[nodiscard]] uchar* bytes() const { return static_cast<uchar*>(address); }
+    };
+
+    // pread until size bytes have arrived, since a single call is allowed to return short
+    bool ReadFully(const int fd, void* buffer, size_t size, off_t offset) {
+        auto* destination = static_cast<char*>(buffer);
+        while (size > 0) {
+            const ssize_t bytes_read = pread(fd, destination, size, offset);
+            if (bytes_read <= 0) return false;
+            destination += bytes_read;
+            offset += bytes_read;
+            size -= static_cast<size_t>(bytes_read);
+        }
+        return true;
+    }
+
+    // pwrite counterpart of ReadFully
+    bool WriteFully(const int fd, const void* buffer, size_t size, off_t offset) {
+        const auto* source = static_cast<const char*>(buffer);
+        while (size > 0) {
+            const ssize_t bytes_written = pwrite(fd, source, size, offset);
+            if (bytes_written <= 0) return false;
+            source += bytes_written;
+            offset += bytes_written;
+            size -= static_cast<size_t>(bytes_written);
+        }
+        return true;
+    }
+
+    size_t FrameBytes(const cv::Mat& frame) {
+        return frame.total() * frame.elemSize();
+    }
+
+    // Thread limits shared by every ThreadPool
+    std::mutex thread_limit_mutex;
+    int max_threads = -1; // -1 until QUEST_MAX_THREADS has been read
+    bool limit_opencv_threads = true;
+    int parallel_regions = 0; // Library work running on several threads, OpenCV is held to one while there is any
+    int saved_opencv_threads = -1;
+    int reserved_threads = 0; // Held by ThreadPool::Reservation for threads outside the pools
+
+    // The pool and queue of the worker running on this thread, if it is one
+    thread_local const void* worker_pool = nullptr;
+    thread_local size_t worker_queue = 0;
+    // The pool this thread is already using from outside, so nested calls into it don't lock it again
+    thread_local const void* using_pool = nullptr;
+
+    // Must be called with thread_limit_mutex held
+    int MaxThreadsLocked() {
+        if (max_threads < 0) {
+            const char* env_max = std::getenv("QUEST_MAX_THREADS");
+            max_threads = env_max ? std::max(0, std::atoi(env_max)) : 0;
+            if (max_threads > 0) cv::setNumThreads(max_threads);
+        }
+        return max_threads;
+    }
+
+    int ResolveThreadCount(const int requested) {
+        int count = requested > 0 ? requested : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        std::lock_guard lock(thread_limit_mutex);
+        if (MaxThreadsLocked() > 0) count = std::min(count, std::max(1, max_threads - reserved_threads));
+        return count;
+    }
+
+    // Holds OpenCV to a single thread while it's alive, so OpenCV calls made from several library threads at once
+    // don't each fan out over every core. Nests, and restores OpenCV's thread count once the last one goes
+    class OpenCvThreadLimit {
+        bool active = false;
+
+    public:
+        explicit OpenCvThreadLimit(const bool parallel) {
+            std::lock_guard lock(thread_limit_mutex);
+            if (!parallel || !limit_opencv_threads) return;
+            active = true;
+            if (parallel_regions++ == 0) {
+                saved_opencv_threads = cv::getNumThreads();
+                cv::setNumThreads(1);
+            }
+        }
+        OpenCvThreadLimit(const OpenCvThreadLimit&) = delete;
+        OpenCvThreadLimit& operator=(const OpenCvThreadLimit&) = delete;
+
+        ~OpenCvThreadLimit() {
+            if (!active) return;
+            std::lock_guard lock(thread_limit_mutex);
+            if (--parallel_regions == 0) cv::setNumThreads(saved_opencv_threads);
+        }
+    };
+
+    void ParallelFor(const int count, const std::function<void(int)>& fn, const int max_workers = 0) {
+        Quest::ThreadPool::global().parallel_for(count, fn, max_workers);
+    }
+
+    // Decode one container frame from its bytes. Raw frames become views into the owner's memory when there is an
+    // owner to keep alive, and copies otherwise
+    cv::Mat DecodeContainerFrame(const Quest::ContainerIndexEntry& entry, uchar* data, std::shared_ptr<void> owner) {
+        if (entry.codec[0] != '\0') {
+            return cv::imdecode(cv::Mat(1, static_cast<int>(entry.size), CV_8UC1, data), cv::IMREAD_UNCHANGED);
+        }
+        if (owner) {
+            return WrapSharedBuffer(entry.rows, entry.cols, entry.type, data, entry.step, std::move(owner));
+        }
+        return cv::Mat(entry.rows, entry.cols, entry.type, data, entry.step).clone();
+    }
+
+    // Gives render the frame at an index, however the sequence is holding it
+    using FrameGetter = std::function<cv::Mat(int)>;
+
+    // Picks out frames by index, such as those whose files render can leave as they are
+    using FrameFilter = std::function<bool(int)>;
+
+    // Thrown between frames once an operation's CancelToken is cancelled. Not a std::exception, so it passes
+    // through the handlers that turn decode errors into fallbacks
+    struct OperationCancelled {};
+
+    // Counts finished frames for a ProgressCallback, calling it one frame at a time
+    class ProgressCounter {
+        const Quest::ProgressCallback& progress;
+        std::mutex mutex;
+        int done = 0;
+
+    public:
+        int total = 0;
+
+        explicit ProgressCounter(const Quest::ProgressCallback& new_progress) : progress(new_progress) {}
+
+        void frame_done() {
+            if (!progress) return;
+            std::lock_guard lock(mutex);
+            progress(++done, total);
+        }
+    };
+
+    // Frames are encoded in parallel a batch at a time and appended in order, so memory stays bounded by the batch
+    bool WriteContainer(const std::filesystem::path& container_path, int frame_count, const FrameGetter& frames,
+        const double fps, const std::string& codec, const std::vector<int>& params) {
+        std::ofstream file(container_path, std::ios::binary | std::ios::trunc);
+        if (!file) return false;
+
+        char file_header[Quest::container_alignment] = {};
+        std::memcpy(file_header, Quest::container_magic, sizeof(Quest::container_magic));
+        std::memcpy(file_header + sizeof(Quest::container_magic), &Quest::container_version, sizeof(uint32_t));
+        file.write(file_header, Quest::container_alignment);
+
+        std::vector<Quest::ContainerIndexEntry> index(frame_count);
+        uint64_t offset = Quest::container_alignment;
+        const int batch_size = 2 * Quest::ThreadPool::global().get_thread_count();
+        std::vector<cv::Mat> batch_frames(batch_size);
+        std::vector<cv::Mat> batch_pixels(batch_size);
+        std::vector<std::vector<uchar>> batch_encoded(batch_size);
+        const char padding[Quest::container_alignment] = {};
+
+        for (int batch_start = 0; batch_start < frame_count; batch_start += batch_size) {
+            const int batch_end = std::min(batch_start + batch_size, frame_count);
+            ParallelFor(batch_end - batch_start, [&](const int b) {
+                const cv::Mat& frame = batch_frames[b] = frames(batch_start + b);
+                if (frame.empty()) {
+                    return;
+                } else if (codec.empty()) {
+                    batch_pixels[b] = frame.isContinuous() ? frame : frame.clone();
+                } else if (!cv::imencode(codec, frame, batch_encoded[b], params)) {
+                    throw Quest::SeqException("Failed to encode a frame for the container");
+                }
+            });
+
+            for (int i = batch_start; i < batch_end; i++) {
+                const int b = i - batch_start;
+                if (batch_frames[b].empty()) {
+                    // The source ran out early, so the container ends at the last frame it had
+                    index.resize(i);
+                    frame_count = i;
+                    break;
+                }
+                Quest::ContainerIndexEntry& entry = index[i];
+                entry.offset = offset;
+                const cv::Mat& frame = batch_frames[b];
+                entry.rows = frame.rows;
+                entry.cols = frame.cols;
+                entry.type = frame.type();
+                if (codec.empty()) {
+                    entry.step = static_cast<uint32_t>(frame.cols * frame.elemSize());
+                    entry.size = static_cast<uint64_t>(entry.step) * entry.rows;
+                    file.write(reinterpret_cast<const char*>(batch_pixels[b].data), static_cast<std::streamsize>(entry.size));
+                    batch_pixels[b].release();
+                } else {
+                    std::strncpy(entry.codec, codec.c_str(), sizeof(entry.codec) - 1);
+                    entry.size = batch_encoded[b].size();
+                    file.write(reinterpret_cast<const char*>(batch_encoded[b].data()), static_cast<std::streamsize>(entry.size));
+                    std::vector<uchar>().swap(batch_encoded[b]);
+                }
+                batch_frames[b].release();
+                const uint64_t padded_size = (entry.size + Quest::container_alignment - 1) / Quest::container_alignment
+                    * Quest::container_alignment;
+                file.write(padding, static_cast<std::streamsize>(padded_size - entry.size));
+                offset += padded_size;
+            }
+        }
+
+        Quest::ContainerFooter footer {};
+        std::memcpy(footer.magic, Quest::container_magic, sizeof(Quest::container_magic));
+        footer.version = Quest::container_version;
+        footer.index_offset = offset;
+        footer.frame_count = index.size();
+        footer.fps = fps;
+        file.write(reinterpret_cast<const char*>(index.data()),
+            static_cast<std::streamsize>(index.size() * sizeof(Quest::ContainerIndexEntry)));
+        file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+        return static_cast<bool>(file);
+    }
+
+    // DPX header fields this library reads or writes, as byte offsets from the start of the file
+    namespace DpxOffsets {
+        constexpr size_t magic = 0;
+        constexpr size_t image_offset = 4;
+        constexpr size_t version = 8;
+        constexpr size_t file_size = 16;
+        constexpr size_t ditto_key = 20;
+        constexpr size_t generic_size = 24;
+        constexpr size_t industry_size = 28;
+        constexpr size_t element_count = 770;
+        constexpr size_t pixels_per_line = 772;
+        constexpr size_t lines_per_element = 776;
+        constexpr size_t ref_high_data = 792;
+        constexpr size_t ref_high_quantity = 796;
+        constexpr size_t descriptor = 800;
+        constexpr size_t transfer = 801;
+        constexpr size_t colorimetric = 802;
+        constexpr size_t bit_size = 803;
+        constexpr size_t packing = 804;
+        constexpr size_t encoding = 806;
+        constexpr size_t data_offset = 808;
+        constexpr size_t eol_padding = 812;
+    }
+    constexpr uint32_t dpx_magic = 0x53445058; // "SDPX" when read in the file's byte order
+    constexpr uint8_t dpx_descriptor_luma = 6;
+    constexpr uint8_t dpx_descriptor_rgb = 50;
+    constexpr uint8_t dpx_descriptor_rgba = 51;
+    constexpr uint32_t dpx_undefined = 0xFFFFFFFF;
+
+    // Unsigned integer of the same width as T, for byte swapping
+    template<typename T>
+    using DpxBits = std::conditional_t<sizeof(T) == 2, uint16_t, uint32_t>;
+
+    template<typename T>
+    T LoadDpxValue(const uchar* bytes, const bool swap) {
+        DpxBits<T> bits;
+        std::memcpy(&bits, bytes, sizeof(T));
+        if (swap) bits = sizeof(T) == 2 ? __builtin_bswap16(bits) : __builtin_bswap32(bits);
+        return std::bit_cast<T>(bits);
+    }
+
+    template<typename T>
+    void StoreBigEndian(uchar* bytes, const T value) {
+        auto bits = std::bit_cast<DpxBits<T>>(value);
+        if constexpr (std::endian::native == std::endian::little) {
+            bits = sizeof(T) == 2 ? __builtin_bswap16(bits) : __builtin_bswap32(bits);
+        }
+        std::memcpy(bytes, &bits, sizeof(T));
+    }
+
+    // DPX stores RGB(A) while OpenCV wants BGR(A), so component c of a pixel lands in channel DpxChannel(c).
+    // Single channel luma is stored as is
+    constexpr int DpxChannel(const int component, const int channels) {
+        return channels < 3 || component >= 3 ? component : 2 - component;
+    }
+
+    // One 10 bit component of a filled DPX word in a file of either byte order, where Low is the component's lowest
+    // bit in the word. Components are put together from the two bytes they straddle rather than from a byte swapped
+    // word, since SSE2 has no vector byte swap and GCC won't vectorize loops that swap whole words
+    template<bool BigEndian, int Low>
+    uint32_t LoadDpx10BitComponent(const uchar* word) {
+        constexpr int byte = (31 - (Low + 9)) / 8; // Byte holding the component's top bit, counted from the top
+        const uint32_t high = word[BigEndian ? byte : 3 - byte];
+        const uint32_t low = word[BigEndian ? byte + 1 : 2 - byte];
+        return (high << 8 | low) >> (Low - (16 - 8 * byte)) & 0x3FF;
+    }
+
+    // Replicate the top bits into the bottom so 1023 widens to 65535
+    ushort WidenDpx10Bit(const uint32_t value) {
+        return static_cast<ushort>(value << 6 | value >> 4);
+    }
+
+    template<typename T>
+    uint32_t NarrowToDpx10Bit(const T value) {
+        if constexpr (sizeof(T) == 2) return value >> 6;
+        else return static_cast<uint32_t>(value) << 2 | value >> 6;
+    }
+
+    // 10 bit RGB has exactly one pixel per 32 bit word. The byte order and packing method are template parameters
+    // so each file runs a straight line loop of loads, shifts and masks that GCC vectorizes at -O3
+    template<bool BigEndian, int Shift>
+    void UnpackDpx10BitRgbRow(const uchar* __restrict src, ushort* __restrict dst, const int pixels) {
+        for (int p = 0; p < pixels; p++) {
+            const uchar* word = src + 4 * static_cast<size_t>(p);
+            dst[3 * p] = WidenDpx10Bit(LoadDpx10BitComponent<BigEndian, Shift - 20>(word));
+            dst[3 * p + 1] = WidenDpx10Bit(LoadDpx10BitComponent<BigEndian, Shift - 10>(word));
+            dst[3 * p + 2] = WidenDpx10Bit(LoadDpx10BitComponent<BigEndian, Shift>(word));
+        }
+    }
+
+    // Any other 10 bit layout is a stream of components packed three to a word, unpacked in file order
+    template<bool BigEndian, int Shift>
+    void UnpackDpx10BitComponents(const uchar* __restrict src, ushort* __restrict dst, const int components) {
+        const int words = components / 3;
+        for (int w = 0; w < words; w++) {
+            const uchar* word = src + 4 * static_cast<size_t>(w);
+            dst[3 * w] = WidenDpx10Bit(LoadDpx10BitComponent<BigEndian, Shift>(word));
+            dst[3 * w + 1] = WidenDpx10Bit(LoadDpx10BitComponent<BigEndian, Shift - 10>(word));
+            dst[3 * w + 2] = WidenDpx10Bit(LoadDpx10BitComponent<BigEndian, Shift - 20>(word));
+        }
+        const uchar* last = src + 4 * static_cast<size_t>(words);
+        if (components % 3 > 0) dst[3 * words] = WidenDpx10Bit(LoadDpx10BitComponent<BigEndian, Shift>(last));
+        if (components % 3 > 1) dst[3 * words + 1] = WidenDpx10Bit(LoadDpx10BitComponent<BigEndian, Shift - 10>(last));
+    }
+
+    // RGBA and BGRA only differ in where red and blue go, so the same swap converts either way
+    template<typename T>
+    void SwapRedBlue(const T* __restrict src, T* __restrict dst, const int pixels) {
+        for (int p = 0; p < pixels; p++) {
+            dst[4 * p] = src[4 * p + 2];
+            dst[4 * p + 1] = src[4 * p + 1];
+            dst[4 * p + 2] = src[4 * p];
+            dst[4 * p + 3] = src[4 * p + 3];
+        }
+    }
+
+    // Every line of a 10 bit file into a CV_16U frame of its size and channels. RGBA lines are unpacked into a row
+    // buffer in file order and then swapped into place
+    template<bool BigEndian, int Shift>
+    void UnpackDpx10BitFrame(const uchar* data, const size_t line_bytes, cv::Mat& image) {
+        const int channels = image.channels();
+        std::vector<ushort> rgba_row(channels == 4 ? static_cast<size_t>(image.cols) * 4 : 0);
+        for (int y = 0; y < image.rows; y++) {
+            const uchar* src = data + line_bytes * y;
+            auto* dst = image.ptr<ushort>(y);
+            if (channels == 3) {
+                UnpackDpx10BitRgbRow<BigEndian, Shift>(src, dst, image.cols);
+            } else if (channels == 4) {
+                UnpackDpx10BitComponents<BigEndian, Shift>(src, rgba_row.data(), image.cols * 4);
+                SwapRedBlue(rgba_row.data(), dst, image.cols);
+            } else {
+                UnpackDpx10BitComponents<BigEndian, Shift>(src, dst, image.cols);
+            }
+        }
+    }
+
+    // Inverse of the unpack for writing: BGR of an 8 or 16 bit Mat to 10 bit method A RGB words. The big endian
+    // store is a byte swap, so x86 needs SSSE3 (or AVX2) byte shuffles to vectorize this, while NEON always can
+    template<typename T>
+    void PackDpx10BitRgbRow(const T* __restrict src, uchar* __restrict dst, const int pixels) {
+        for (int p = 0; p < pixels; p++) {
+            const uint32_t b = NarrowToDpx10Bit(src[3 * p]);
+            const uint32_t g = NarrowToDpx10Bit(src[3 * p + 1]);
+            const uint32_t r = NarrowToDpx10Bit(src[3 * p + 2]);
+            StoreBigEndian<uint32_t>(dst + 4 * static_cast<size_t>(p), r << 22 | g << 12 | b << 2);
+        }
+    }
+
+    // Components in file order packed three to a word, with the last word of the line zero filled
+    template<typename T>
+    void PackDpx10BitComponents(const T* __restrict src, uchar* __restrict dst, const int components) {
+        const int words = components / 3;
+        for (int w = 0; w < words; w++) {
+            const uint32_t word = NarrowToDpx10Bit(src[3 * w]) << 22 | NarrowToDpx10Bit(src[3 * w + 1]) << 12
+                | NarrowToDpx10Bit(src[3 * w + 2]) << 2;
+            StoreBigEndian<uint32_t>(dst + 4 * static_cast<size_t>(w), word);
+        }
+        if (components % 3 == 0) return;
+        uint32_t last = NarrowToDpx10Bit(src[3 * words]) << 22;
+        if (components % 3 > 1) last |= NarrowToDpx10Bit(src[3 * words + 1]) << 12;
+        StoreBigEndian<uint32_t>(dst + 4 * static_cast<size_t>(words), last);
+    }
+
+    // Every row of an 8 or 16 bit frame into 10 bit method A lines of luma, RGB or RGBA to match its channels
+    template<typename T>
+    void PackDpx10BitFrame(const cv::Mat& image, uchar* data, const size_t line_bytes) {
+        const int channels = image.channels();
+        std::vector<T> rgba_row(channels == 4 ? static_cast<size_t>(image.cols) * 4 : 0);
+        for (int y = 0; y < image.rows; y++) {
+            const T* src = image.ptr<T>(y);
+            uchar* dst = data + line_bytes * y;
+            if (channels == 3) {
+                PackDpx10BitRgbRow(src, dst, image.cols);
+            } else if (channels == 4) {
+                SwapRedBlue(src, rgba_row.data(), image.cols);
+                PackDpx10BitComponents(rgba_row.data(), dst, image.cols * 4);
+            } else {
+                PackDpx10BitComponents(src, dst, image.cols);
+            }
+        }
+    }
+
+    // Ask the kernel to start reading a whole file into the page cache in the background, so reading it later
+    // doesn't wait on storage. Only a hint, so failures are ignored
+    void HintFileRead(const std::filesystem::path& file_path) {
+        const int fd = ::open(file_path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+#if defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+        struct stat file_stat {};
+        if (fstat(fd, &file_stat) == 0) {
+            radvisory advice {0, static_cast<int>(std::min<off_t>(file_stat.st_size, std::numeric_limits<int>::max()))};
+            fcntl(fd, F_RDADVISE, &advice);
+        }
+#endif
+        ::close(fd);
+    }
+
+    // Frame files hinted ahead of the ones being read, enough to keep storage busy while every thread decodes
+    int ReadAheadFiles() {
+        return 2 * Quest::ThreadPool::global().get_thread_count();
+    }
+
+    // Read a whole file with as few reads as possible, into a buffer that's reused between calls
+    bool ReadFileBytes(const std::filesystem::path& file_path, std::vector<uchar>& bytes) {
+        const int fd = ::open(file_path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat file_stat {};
+        bool read = fstat(fd, &file_stat) == 0 && file_stat.st_size > 0;
+        if (read) {
+#if defined(POSIX_FADV_SEQUENTIAL)
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            bytes.resize(static_cast<size_t>(file_stat.st_size));
+            read = ReadFully(fd, bytes.data(), bytes.size(), 0);
+        }
+        ::close(fd);
+        return read;
+    }
+
+    // Image files keep their own channels, so grayscale stays single channel and a real alpha is kept. Only colour
+    // frames without an alpha get a pure white one
+    void AddMissingAlpha(cv::Mat& image) {
+        if (image.channels() == 3) Quest::GiveMatPureWhiteAlpha(image);
+    }
+
+    // Whether encoded image bytes hold EXIF metadata: a JPEG "Exif" APP1 segment, a PNG "eXIf" chunk or a WebP "EXIF"
+    // chunk. Only decides whether it's worth decoding again to apply the orientation, so a false positive is harmless
+    bool HasExif(const uchar* data, const size_t size) {
+        constexpr char exif[] = "exif";
+        return std::search(data, data + size, exif, exif + 4, [](const uchar byte, const char c) {
+            return std::tolower(byte) == c;
+        }) != data + size;
+    }
+
+    // Regular image formats open at their own bit depth and channels. IMREAD_UNCHANGED keeps alpha but ignores the
+    // EXIF orientation, so a frame without alpha from a file with EXIF is decoded again the way cv::imread turns it
+    cv::Mat DecodeImageBytes(const uchar* data, const size_t size) {
+        const cv::Mat encoded(1, static_cast<int>(size), CV_8UC1, const_cast<uchar*>(data));
+        cv::Mat image = cv::imdecode(encoded, cv::IMREAD_UNCHANGED);
+        if (!image.empty() && image.channels() % 2 == 1 && HasExif(data, size)) {
+            cv::Mat oriented = cv::imdecode(encoded, cv::IMREAD_ANYDEPTH | cv::IMREAD_ANYCOLOR);
+            if (!oriented.empty()) image = oriented;
+        }
+        if (!image.empty()) AddMissingAlpha(image);
+        return image;
+    }
+
+    // The file is read in one go and decoded from memory rather than left to the decoder to read in small pieces.
+    // OpenCV's JPEG 2000 decoder can't decode from memory and would go through a temporary file, so it reads its own
+    // files, which don't carry EXIF. Each thread reuses its buffer between the similar sized files of a sequence, but
+    // frees it after a file over 32MB, or once it's more than twice the file just read, so every pool thread doesn't
+    // hold on to the largest file it ever read
+    cv::Mat ReadImageFrame(const std::filesystem::path& file_path) {
+        constexpr size_t max_kept_bytes = 32 << 20;
+        cv::Mat image;
+        thread_local std::vector<uchar> file_bytes;
+        if (file_path.extension() != ".jp2" && ReadFileBytes(file_path, file_bytes)) {
+            image = DecodeImageBytes(file_bytes.data(), file_bytes.size());
+        }
+        if (file_bytes.capacity() > std::min(max_kept_bytes, 2 * file_bytes.size())) {
+            std::vector<uchar>().swap(file_bytes);
+        }
+        if (image.empty()) {
+            image = cv::imread(file_path, cv::IMREAD_UNCHANGED);
+            if (!image.empty()) AddMissingAlpha(image);
+        }
+        return image;
+    }
+
+    // Value representing full intensity for a depth - integer formats use their full range, floats use 0-1
+    double DepthMaxValue(const int depth) {
+        switch (depth) {
+        case CV_8U: return 255;
+        case CV_8S: return 127;
+        case CV_16U: return 65535;
+        case CV_16S: return 32767;
+        case CV_32S: return 2147483647;
+        default: return 1;
+        }
+    }
+
+    // Convert a Mat to another depth, rescaling so full intensity stays full intensity
+    cv::Mat ConvertDepth(const cv::Mat& image, const int depth) {
+        if (image.depth() == depth) return image;
+        cv::Mat converted = Quest::FramePool::global().acquire(image.size(), CV_MAKETYPE(depth, image.channels()));
+        image.convertTo(converted, depth, DepthMaxValue(depth) / DepthMaxValue(image.depth()));
+        return converted;
+    }
+
+    // cv::imwrite quietly truncates depths an encoder can't store, so scale those down to the deepest one it can
+    cv::Mat ConvertForImageWriter(const cv::Mat& frame, const std::string& extension) {
+        const bool writes_16_bit = extension == ".png" || extension == ".tiff" || extension == ".tif" || extension == ".jp2";
+        const bool writes_float = extension == ".tiff" || extension == ".tif";
+        const int depth = frame.depth();
+        if (depth == CV_8U || (depth == CV_16U && writes_16_bit) || (depth == CV_32F && writes_float)) return frame;
+        return ConvertDepth(frame, writes_16_bit ? CV_16U : CV_8U);
+    }
+
+    cv::Mat ReadExrFrame(const std::filesystem::path& file_path) {
+        return cv::imread(file_path, cv::IMREAD_UNCHANGED);
+    }
+
+    // EXR only stores half or full floats, so integer frames are normalised to 0-1 before writing
+    bool WriteExrFrame(const std::filesystem::path& file_path, const cv::Mat& image, const std::vector<int>& params) {
+        if (image.depth() == CV_32F || image.depth() == CV_16F) {
+            return cv::imwrite(file_path, image, params);
+        }
+        return cv::imwrite(file_path, ConvertDepth(image, CV_32F), params);
+    }
+
+    // Decode an in-memory frame file the way its file would be read. EXR data, told apart by its magic number, keeps
+    // its float channels and everything else gets ReadImageFrame's channels and alpha
+    cv::Mat DecodeFrameBytes(const std::vector<uchar>& bytes) {
+        if (bytes.empty()) return {};
+        constexpr uchar exr_magic[] = {0x76, 0x2f, 0x31, 0x01};
+        if (bytes.size() >= sizeof(exr_magic) && std::equal(std::begin(exr_magic), std::end(exr_magic), bytes.begin())) {
+            const cv::Mat encoded(1, static_cast<int>(bytes.size()), CV_8UC1, const_cast<uchar*>(bytes.data()));
+            return cv::imdecode(encoded, cv::IMREAD_UNCHANGED);
+        }
+        return DecodeImageBytes(bytes.data(), bytes.size());
+    }
+
+    // Encode a frame into the bytes of a file with the given extension, converted the same way render writes one
+    bool EncodeFrameBytes(const cv::Mat& frame, const std::string& extension, const std::vector<int>& params,
+        std::vector<uchar>& bytes) {
+        if (extension == Quest::exr_extension) {
+            const bool is_float = frame.depth() == CV_32F || frame.depth() == CV_16F;
+            return cv::imencode(extension, is_float ? frame : ConvertDepth(frame, CV_32F), bytes, params);
+        }
+        return cv::imencode(extension, ConvertForImageWriter(frame, extension), bytes, params);
+    }
+
+    // Anonymous, page aligned mapping that holds every frame of a sequence back to back
+    struct FrameArena {
+        void* address = MAP_FAILED;
+        size_t length = 0;
+
+        FrameArena(const size_t bytes, const bool huge_pages) {
+            const size_t page_size = huge_pages ? 2 << 20 : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            length = (bytes + page_size - 1) / page_size * page_size;
+#ifdef MAP_HUGETLB
+            if (huge_pages) {
+                address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            }
+#endif
+            if (address == MAP_FAILED) {
+                address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+                if (huge_pages && address != MAP_FAILED) madvise(address, length, MADV_HUGEPAGE);
+#endif
+            }
+        }
+
+        ~FrameArena() {
+            if (address != MAP_FAILED) munmap(address, length);
+        }
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        [[nodiscard]] bool valid() const { return address != MAP_FAILED; }
+    };
+
+    // Fill every slot with a view into one new arena sized for frames of rows x cols x type, each starting on a cache
+    // line. Returns the whole arena as a continuous byte Mat, or an empty Mat (leaving the slots alone) if the
+    // arena couldn't be mapped, in which case frames just get allocated individually
+    cv::Mat AllocateFrameArena(std::vector<cv::Mat>& slots, const int rows, const int cols, const int type,
+        const bool huge_pages) {
+        const size_t row_bytes = static_cast<size_t>(cols) * CV_ELEM_SIZE(type);
+        const size_t slot_bytes = (row_bytes * rows + 63) / 64 * 64;
+        auto frame_arena = std::make_shared<FrameArena>(slot_bytes * slots.size(), huge_pages);
+        if (!frame_arena->valid()) return {};
+
+        auto* base = static_cast<uchar*>(frame_arena->address);
+        for (size_t i = 0; i < slots.size(); i++) {
+            slots[i] = WrapSharedBuffer(rows, cols, type, base + slot_bytes * i, row_bytes, frame_arena);
+        }
+        // cv::Mat dimensions are ints, so the arena is shaped as rows of one page to cover more than 2 GB
+        const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return WrapSharedBuffer(static_cast<int>(frame_arena->length / page_size), static_cast<int>(page_size), CV_8UC1,
+            base, page_size, frame_arena);
+    }
+
+    // Put a decoded frame into its slot. A slot that is already an arena view of the same size and type gets the
+    // pixels copied in so the frame lives in the arena, anything else just takes the decoded Mat
+    void StoreFrame(cv::Mat& slot, const cv::Mat& decoded) {
+        if (!slot.empty() && slot.size() == decoded.size() && slot.type() == decoded.type()) {
+            decoded.copyTo(slot);
+        } else {
+            slot = decoded;
+        }
+    }
+
+    // In memory encoding for FrameStorage::Compressed. PNG at its fastest level is lossless for 8 and 16 bit frames
+    // with 1, 3 or 4 channels, anything else gets an empty buffer back and is kept decoded
+    std::vector<uchar> CompressFrame(const cv::Mat& frame) {
+        std::vector<uchar> compressed;
+        const int depth = frame.depth();
+        const int channels = frame.channels();
+        if (frame.empty() || (depth != CV_8U && depth != CV_16U) || channels == 2 || channels > 4) return compressed;
+        if (!cv::imencode(".png", frame, compressed, {cv::IMWRITE_PNG_COMPRESSION, 1})) compressed.clear();
+        return compressed;
+    }
+
+    cv::Mat DecompressFrame(const std::vector<uchar>& compressed) {
+        return cv::imdecode(compressed, cv::IMREAD_UNCHANGED);
+    }
+
+    // Cheap hash of a frame's size, type and pixels, used to tell whether a hot frame was changed while decoded
+    uint64_t FrameChecksum(const cv::Mat& frame) {
+        constexpr uint64_t multiplier = 0x9E3779B97F4A7C15;
+        uint64_t hash = (static_cast<uint64_t>(frame.rows) << 32 | static_cast<uint32_t>(frame.cols)) * multiplier
+            ^ frame.type();
+        const size_t row_bytes = frame.cols * frame.elemSize();
+        for (int y = 0; y < frame.rows; y++) {
+            const uchar* row = frame.ptr(y);
+            size_t x = 0;
+            for (; x + sizeof(uint64_t) <= row_bytes; x += sizeof(uint64_t)) {
+                uint64_t word;
+                std::memcpy(&word, row + x, sizeof(word));
+                hash = (std::rotl(hash, 5) ^ word) * multiplier;
+            }
+            for (; x < row_bytes; x++) hash = (std::rotl(hash, 5) ^ row[x]) * multiplier;
+        }
+        return hash;
+    }
+
+    // Where open() puts each decoded frame, by index. An empty Mat clears the frame
+    using FrameStore = std::function<void(int, const cv::Mat&)>;
+
+    // Paths of the consecutive frames on disk for a frame padded path. Sequences start at frame 0 when there is one,
+    // like cv::VideoCapture finds them, and at frame 1 otherwise
+    std::vector<std::string> SequenceFramePaths(const std::filesystem::path& sequence_path) {
+        Quest::SeqPath seq(sequence_path, 0);
+        if (!std::filesystem::exists(seq.outputPath())) seq.increment();
+        std::vector<std::string> frame_paths;
+        for (std::string path = seq.outputIncrement(); std::filesystem::exists(path); path = seq.outputIncrement()) {
+            frame_paths.push_back(std::move(path));
+        }
+        return frame_paths;
+    }
+
+    enum class InputType { Image, ImageSequence, Video, Container, Encoded, Unsupported };
+    using FrameFileReader = cv::Mat (*)(const std::filesystem::path&);
+
+    // What kind of input a path is, from its extension and frame padding, and for frame file formats the reader for
+    // their frames. Everything that reads inputs goes through this so they all accept the same paths as open().
+    // Frame files are read directly rather than through cv::VideoCapture, which would force them to 8 bit
+    InputType DetectInputType(const std::filesystem::path& path, FrameFileReader* read_frame = nullptr) {
+        const std::string extension = path.extension();
+        FrameFileReader reader = nullptr;
+        for (const std::string& image_extension : Quest::supported_image_extensions) {
+            if (extension == image_extension) reader = ReadImageFrame;
+        }
+        if (extension == Quest::raw_frame_extension) reader = Quest::ReadRawFrame;
+        if (extension == Quest::dpx_extension) reader = Quest::ReadDpxFrame;
+        if (extension == Quest::exr_extension) reader = ReadExrFrame;
+        if (read_frame) *read_frame = reader;
+        if (reader) {
+            return Quest::HasFramePadding(path) ? InputType::ImageSequence : InputType::Image;
+        }
+        if (extension == Quest::container_extension) return InputType::Container;
+        for (const std::string& video_extension : Quest::supported_video_extensions) {
+            if (extension == video_extension) return InputType::Video;
+        }
+        return InputType::Unsupported;
+    }
+
+    // Number of frames ImageSeq::open would give a path, worked out without decoding any of them. 0 if the path can't
+    // be read, nullopt if ImageSeq can't open files with its extension
+    std::optional<int> ProbeFrameCount(const std::filesystem::path& path) {
+        switch (DetectInputType(path)) {
+        case InputType::ImageSequence:
+            return static_cast<int>(SequenceFramePaths(path).size());
+        case InputType::Image:
+            return std::filesystem::exists(path) ? 1 : 0;
+        case InputType::Container: {
+            Quest::SeqContainer container;
+            if (container.open(path) != Quest::SeqErrorCodes::Success) return 0;
+            return container.get_frame_count();
+        }
+        case InputType::Video: {
+            const cv::VideoCapture capture(path);
+            if (!capture.isOpened()) return 0;
+            return std::max(0, static_cast<int>(capture.get(cv::CAP_PROP_FRAME_COUNT)));
+        }
+        default:
+            return std::nullopt;
+        }
+    }
+
+    // Read the next frame of a capture and give it an alpha. Frames decode into pooled buffers sized like the
+    // previous frame, which VideoCapture::read fills in place as long as the size hasn't changed
+    bool ReadVideoFrame(cv::VideoCapture& capture, cv::Mat& frame, cv::Size& previous_size) {
+        frame = Quest::FramePool::global().acquire(previous_size, CV_8UC3);
+        if (!capture.read(frame)) return false;
+        previous_size = frame.size();
+        Quest::GiveMatPureWhiteAlpha(frame);
+        return true;
+    }
+
+    // Decode frames [start, end) of a video on its own VideoCapture. Returns false if the capture can't be opened,
+    // can't seek to start, or runs out of frames before the end of a segment that isn't the last one
+    bool DecodeVideoSegment(const std::filesystem::path& path, const int start, const int end,
+        const bool last_segment, const FrameStore& store) {
+        cv::VideoCapture capture(path);
+        if (!capture.isOpened()) return false;
+        if (start > 0) {
+            capture.set(cv::CAP_PROP_POS_FRAMES, start);
+            if (static_cast<int>(capture.get(cv::CAP_PROP_POS_FRAMES)) != start) return false;
+        }
+        cv::Size frame_size;
+        for (int i = start; i < end; i++) {
+            cv::Mat decoded;
+            if (!ReadVideoFrame(capture, decoded, frame_size)) {
+                // Frame counts are estimates, so running out early in the last segment just leaves empty frames
+                for (int j = i; j < end; j++) store(j, cv::Mat());
+                return last_segment;
+            }
+            store(i, decoded);
+        }
+        return true;
+    }
+
+    // Split frames [first, total_frames) of a video into contiguous segments and decode each one concurrently,
+    // storing frames as they come. Returns false if any segment failed, in which case the caller should fall back
+    // to a serial decode
+    bool DecodeVideoParallel(const std::filesystem::path& path, const int total_frames, const int first,
+        const FrameStore& store) {
+        const int frame_count = total_frames - first;
+        const int workers = std::min(Quest::ThreadPool::global().get_thread_count(),
+            frame_count / Quest::min_video_segment_frames);
+        if (workers < 2) return false;
+
+        std::vector<char> segment_success(workers, false);
+        ParallelFor(workers, [&](const int w) {
+            const int start = first + frame_count * w / workers;
+            const int end = first + frame_count * (w + 1) / workers;
+            try {
+                segment_success[w] = DecodeVideoSegment(path, start, end, w == workers - 1, store);
+            } catch (const std::exception&) {
+                segment_success[w] = false;
+            }
+        });
+        return std::all_of(segment_success.begin(), segment_success.end(), [](const char ok) { return ok; });
+    }
+
+    // Reads an input's frames one at a time, in order, for streaming them through rather than opening the whole
+    // input at once
+    class FrameSource {
+        InputType type = InputType::Unsupported;
+        FrameFileReader read_frame = nullptr;
+        std::vector<std::string> frame_paths;
+        cv::VideoCapture video;
+        cv::Size video_frame_size;
+        Quest::SeqContainer container;
+        int frame_count = 0;
+        int next_frame = 0;
+        double fps = -1;
+
+    public:
+        Quest::SeqErrorCodes open(const std::filesystem::path& path) {
+            type = DetectInputType(path, &read_frame);
+            next_frame = 0;
+            switch (type) {
+            case InputType::Image:
+                if (!std::filesystem::exists(path)) return Quest::SeqErrorCodes::BadPath;
+                frame_paths = {path};
+                break;
+            case InputType::ImageSequence: {
+                frame_paths = SequenceFramePaths(path);
+            } break;
+            case InputType::Video:
+                video.open(path);
+                if (!video.isOpened()) return Quest::SeqErrorCodes::BadPath;
+                frame_count = std::max(0, static_cast<int>(video.get(cv::CAP_PROP_FRAME_COUNT)));
+                fps = video.get(cv::CAP_PROP_FPS);
+                break;
+            case InputType::Container:
+                if (container.open(path) != Quest::SeqErrorCodes::Success) return Quest::SeqErrorCodes::BadPath;
+                frame_count = container.get_frame_count();
+                fps = container.get_fps();
+                break;
+            default:
+                return Quest::SeqErrorCodes::UnsupportedExtension;
+            }
+            if (read_frame) {
+                frame_count = static_cast<int>(frame_paths.size());
+                for (int i = 0; i < std::min(ReadAheadFiles(), frame_count); i++) HintFileRead(frame_paths[i]);
+            }
+            return frame_count > 0 ? Quest::SeqErrorCodes::Success : Quest::SeqErrorCodes::BadPath;
+        }
+
+        // A video's frame count is only an estimate, and drops to the frames actually read if it runs out early
+        [[nodiscard]] int get_frame_count() const { return frame_count; }
+        [[nodiscard]] double get_fps() const { return fps; }
+
+        // The next frame, or an empty Mat once they've run out or one can't be read
+        cv::Mat read() {
+            if (next_frame >= frame_count) return {};
+            const int i = next_frame++;
+            if (read_frame) {
+                if (i + ReadAheadFiles() < frame_count) HintFileRead(frame_paths[i + ReadAheadFiles()]);
+                return read_frame(frame_paths[i]);
+            }
+            if (type == InputType::Container) return container.read_frame(i);
+            cv::Mat frame;
+            if (!ReadVideoFrame(video, frame, video_frame_size)) {
+                frame_count = i;
+                return {};
+            }
+            return frame;
+        }
+    };
+
+    // Translate the render options relevant to an image extension into cv::imwrite params
+    std::vector<int> ImageWriteParams(const std::string& extension, const Quest::RenderOptions& options) {
+        std::vector<int> params;
+        if (extension == ".png") {
+            if (options.png_compression >= 0) params.insert(params.end(), {cv::IMWRITE_PNG_COMPRESSION, options.png_compression});
+            if (options.png_strategy >= 0) params.insert(params.end(), {cv::IMWRITE_PNG_STRATEGY, options.png_strategy});
+        } else if (extension == ".jpg" || extension == ".jpeg" || extension == ".jpe") {
+            if (options.jpeg_quality >= 0) params.insert(params.end(), {cv::IMWRITE_JPEG_QUALITY, options.jpeg_quality});
+            if (options.jpeg_progressive) params.insert(params.end(), {cv::IMWRITE_JPEG_PROGRESSIVE, 1});
+        } else if (extension == ".webp") {
+            if (options.webp_quality >= 0) params.insert(params.end(), {cv::IMWRITE_WEBP_QUALITY, options.webp_quality});
+        } else if (extension == ".tiff" || extension == ".tif") {
+            if (options.tiff_compression >= 0) params.insert(params.end(), {cv::IMWRITE_TIFF_COMPRESSION, options.tiff_compression});
+        } else if (extension == Quest::exr_extension) {
+            if (options.exr_type >= 0) params.insert(params.end(), {cv::IMWRITE_EXR_TYPE, options.exr_type});
+            if (options.exr_compression >= 0) params.insert(params.end(), {cv::IMWRITE_EXR_COMPRESSION, options.exr_compression});
+        }
+        return params;
+    }
+
+    // Video encoders only take 3 channel frames at the writer's size, so drop the alpha channel open() adds
+    // and resize anything that doesn't match
+    cv::Mat ConvertForVideo(const cv::Mat& frame, const cv::Size& frame_size) {
+        Quest::FramePool& pool = Quest::FramePool::global();
+        const cv::Mat eight_bit = ConvertDepth(frame, CV_8U);
+        cv::Mat converted;
+        switch (eight_bit.channels()) {
+        case 4:
+            converted = pool.acquire(eight_bit.size(), CV_8UC3);
+            cv::cvtColor(eight_bit, converted, cv::COLOR_BGRA2BGR);
+            break;
+        case 1:
+            converted = pool.acquire(eight_bit.size(), CV_8UC3);
+            cv::cvtColor(eight_bit, converted, cv::COLOR_GRAY2BGR);
+            break;
+        default: converted = eight_bit;
+        }
+        if (converted.size() != frame_size) {
+            cv::Mat resized = pool.acquire(frame_size, converted.type());
+            cv::resize(converted, resized, frame_size, 0, 0, cv::INTER_AREA);
+            return resized;
+        }
+        return converted;
+    }
+
+    // Frames are converted concurrently on the thread pool while the calling thread encodes them in output order, with
+    // at most two per pool thread in flight at once
+    void WriteVideoPipelined(cv::VideoWriter& writer, const int frame_count, const FrameGetter& frames,
+        const cv::Size& frame_size) {
+        Quest::ThreadPool& pool = Quest::ThreadPool::global();
+        const OpenCvThreadLimit opencv_limit(pool.get_thread_count() > 1);
+        const auto max_in_flight = static_cast<size_t>(2 * pool.get_thread_count());
+        std::deque<std::future<cv::Mat>> converted_frames;
+        std::exception_ptr error;
+
+        int next = 0;
+        while (next < frame_count || !converted_frames.empty()) {
+            while (!error && next < frame_count && converted_frames.size() < max_in_flight) {
+                converted_frames.push_back(pool.submit([&frames, &frame_size, i = next++] {
+                    const cv::Mat frame = frames(i);
+                    return frame.empty() ? frame : ConvertForVideo(frame, frame_size);
+                }));
+            }
+            if (converted_frames.empty()) break;
+            // Conversions still in flight hold references to frames, so they're waited for even after a failure
+            try {
+                const cv::Mat frame = pool.wait(converted_frames.front());
+                if (!error && !frame.empty()) writer.write(frame);
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+            converted_frames.pop_front();
+        }
+
+        if (error) std::rethrow_exception(error);
+    }
+
+    // Hidden name beside a render output for writing it before it's complete. The extension is kept since OpenCV picks
+    // its encoder from it
+    std::filesystem::path PartialRenderPath(const std::filesystem::path& path) {
+        return path.parent_path() / ("." + path.stem().string() + ".partial" + path.extension().string());
+    }
+
+    // Write a file under its partial name and rename it into place once write succeeds. The rename replaces any old
+    // file in one step, so a render that dies part way leaves either the old file or the new one, never half of one
+    bool WriteAtomically(const std::filesystem::path& path,
+        const std::function<bool(const std::filesystem::path&)>& write) {
+        const std::filesystem::path partial_path = PartialRenderPath(path);
+        std::error_code error;
+        bool written = false;
+        try {
+            written = write(partial_path);
+        } catch (...) {
+            std::filesystem::remove(partial_path, error);
+            throw;
+        }
+        if (written) std::filesystem::rename(partial_path, path, error);
+        if (!written || error) {
+            std::filesystem::remove(partial_path, error);
             return false;
         }
         return true;
     }
-    return false;
+
+    // Hidden file beside a resumable sequence render listing the frames that have been written, with each file's size
+    // and the checksum of the frame written to it. The first line holds the render settings, so a record left by a
+    // render with other settings is ignored. Frames are appended as they finish, and the record is removed once the
+    // whole sequence has been written
+    class RenderRecord {
+        struct WrittenFrame {
+            uintmax_t file_size = 0;
+            uint64_t checksum = 0;
+        };
+
+        std::filesystem::path record_path;
+        std::vector<std::optional<WrittenFrame>> written_frames;
+        std::mutex record_mutex;
+        int fd = -1;
+
+    public:
+        RenderRecord(const std::filesystem::path& output_path, const std::string& settings, const int frame_count)
+            : written_frames(frame_count) {
+            record_path = output_path.parent_path() / ("." + output_path.filename().string() + ".render");
+            // A line cut short by the render dying fails to parse and ends the record there
+            std::ifstream record(record_path);
+            std::string header;
+            const bool matching_record = std::getline(record, header) && header == settings;
+            int i;
+            WrittenFrame frame;
+            while (matching_record && record >> i >> frame.file_size >> frame.checksum) {
+                if (i >= 0 && i < frame_count) written_frames[i] = frame;
+            }
+            if (matching_record) {
+                fd = ::open(record_path.c_str(), O_WRONLY | O_APPEND);
+            } else {
+                written_frames.assign(frame_count, std::nullopt);
+                fd = ::open(record_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+                if (fd >= 0) append(settings + "\n");
+            }
+        }
+        RenderRecord(const RenderRecord&) = delete;
+        RenderRecord& operator=(const RenderRecord&) = delete;
+        ~RenderRecord() {
+            if (fd >= 0) ::close(fd);
+        }
+
+        // Whether frame i was written by an earlier render and its file is still all there
+        bool is_written(const int i, const std::filesystem::path& frame_path, const uint64_t checksum) const {
+            const std::optional<WrittenFrame>& frame = written_frames[i];
+            std::error_code error;
+            if (!frame || frame->checksum != checksum) return false;
+            return std::filesystem::file_size(frame_path, error) == frame->file_size && !error;
+        }
+
+        void written(const int i, const std::filesystem::path& frame_path, const uint64_t checksum) {
+            std::error_code error;
+            const uintmax_t file_size = std::filesystem::file_size(frame_path, error);
+            if (error) return;
+            std::lock_guard lock(record_mutex);
+            append(std::to_string(i) + " " + std::to_string(file_size) + " " + std::to_string(checksum) + "\n");
+        }
+
+        void remove() {
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+            std::error_code error;
+            std::filesystem::remove(record_path, error);
+        }
+
+    private:
+        // Recording stops at the first failed write, which only costs a later resume some frames
+        void append(const std::string& line) {
+            if (fd >= 0 && ::write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    };
+
+    // Write every frame of a frame padded sequence in parallel, each one atomically. With resume, every frame written
+    // is noted in the render record and frames the record shows were already written from the same pixels are left
+    // as they are. Without it there's no record to keep, or checksums to take. Frames unchanged picks out whose files
+    // are still there are left alone too, without even being fetched
+    bool WriteFrameFiles(const std::filesystem::path& output_path, const int frame_count, const FrameGetter& frame_at,
+        const std::function<bool(const std::filesystem::path&, const cv::Mat&)>& write_frame,
+        const std::string& settings, const bool resume, const FrameFilter& unchanged) {
+        std::vector<std::string> frame_paths(frame_count);
+        Quest::SeqPath output_seq(output_path);
+        for (std::string& frame_path : frame_paths) frame_path = output_seq.outputIncrement();
+
+        std::optional<RenderRecord> record;
+        if (resume) record.emplace(output_path, settings, frame_count);
+        std::atomic<bool> written = true;
+        ParallelFor(frame_count, [&](const int i) {
+            if (unchanged && std::filesystem::exists(frame_paths[i]) && unchanged(i)) return;
+            const cv::Mat frame = frame_at(i);
+            if (frame.empty()) return; // Past the end of a source that ran out early
+            const uint64_t checksum = record ? FrameChecksum(frame) : 0;
+            if (record && record->is_written(i, frame_paths[i], checksum)) return;
+            const bool frame_written = WriteAtomically(frame_paths[i], [&](const std::filesystem::path& path) {
+                return write_frame(path, frame);
+            });
+            if (!frame_written) {
+                written = false;
+            } else if (record) {
+                record->written(i, frame_paths[i], checksum);
+            }
+        });
+        if (written && record) record->remove();
+        return written;
+    }
+
+    // Write frame_count frames fetched by index to output_path. Frames are fetched by value, so compressed or
+    // spilled frames are decoded by whichever render thread needs them. Every file is written under a partial name
+    // and renamed into place when it's complete. Frames unchanged picks out are left alone in frame padded sequences,
+    // while single file outputs are always written whole
+    Quest::SeqErrorCodes RenderFrames(const std::filesystem::path& output_path, const Quest::RenderOptions& options,
+        const int frame_count, const FrameGetter& frame_at, const cv::Size& frame_size, const double fps,
+        const FrameFilter& unchanged = nullptr) {
+        if (!is_directory(output_path.parent_path())) {
+            return Quest::SeqErrorCodes::BadPath;
+        }
+
+        const std::string extension = output_path.extension();
+        if (extension == Quest::container_extension) {
+            const std::string& codec = options.container_codec;
+            const std::vector<std::string>& codecs = Quest::supported_image_extensions;
+            if (!codec.empty() && std::find(codecs.begin(), codecs.end(), codec) == codecs.end()) {
+                throw Quest::SeqException("Container codec must be empty or one of the supported image extensions");
+            }
+            const bool written = WriteAtomically(output_path, [&](const std::filesystem::path& path) {
+                return WriteContainer(path, frame_count, frame_at, fps, codec, ImageWriteParams(codec, options));
+            });
+            return written ? Quest::SeqErrorCodes::Success : Quest::SeqErrorCodes::BadPath;
+        }
+
+        const std::vector<int> params = ImageWriteParams(extension, options);
+        std::function<bool(const std::filesystem::path&, const cv::Mat&)> write_frame;
+        if (extension == Quest::raw_frame_extension) write_frame = Quest::WriteRawFrame;
+        if (extension == Quest::dpx_extension) write_frame = Quest::WriteDpxFrame;
+        if (extension == Quest::exr_extension) {
+            write_frame = [&params](const std::filesystem::path& path, const cv::Mat& frame) {
+                return WriteExrFrame(path, frame, params);
+            };
+        }
+        for (const std::string& valid : Quest::supported_image_extensions) {
+            if (extension == valid) {
+                write_frame = [&params, &extension](const std::filesystem::path& path, const cv::Mat& frame) {
+                    return cv::imwrite(path, ConvertForImageWriter(frame, extension), params);
+                };
+            }
+        }
+        if (write_frame) {
+            if (Quest::HasFramePadding(output_path)) {
+                std::string settings = extension;
+                for (const int param : params) settings += " " + std::to_string(param);
+                const bool written = WriteFrameFiles(output_path, frame_count, frame_at, write_frame, settings,
+                    options.resume, unchanged);
+                return written ? Quest::SeqErrorCodes::Success : Quest::SeqErrorCodes::BadPath;
+            }
+            if (frame_count > 1) {
+                return Quest::SeqErrorCodes::BadPath;
+            }
+            const bool written = WriteAtomically(output_path, [&](const std::filesystem::path& path) {
+                return write_frame(path, frame_at(0));
+            });
+            return written ? Quest::SeqErrorCodes::Success : Quest::SeqErrorCodes::BadPath;
+        }
+
+        for (const std::string& video_extension : Quest::supported_video_extensions) {
+            if (extension == video_extension) {
+                const std::string& codec = options.video_codec;
+                if (codec.size() != 4) {
+                    throw Quest::SeqException("Video codec must be given as a four character code");
+                }
+                const double render_fps = fps == -1 ? Quest::default_fps : fps;
+                std::vector<int> video_params;
+                if (options.video_quality >= 0) {
+                    video_params.insert(video_params.end(), {cv::VIDEOWRITER_PROP_QUALITY, options.video_quality});
+                }
+
+                const bool written = WriteAtomically(output_path, [&](const std::filesystem::path& path) {
+                    cv::VideoWriter output_writer(path,
+                        cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]),
+                        render_fps, frame_size, video_params);
+                    if (!output_writer.isOpened()) return false;
+                    WriteVideoPipelined(output_writer, frame_count, frame_at, frame_size);
+                    output_writer.release();
+                    return true;
+                });
+                return written ? Quest::SeqErrorCodes::Success : Quest::SeqErrorCodes::BadPath;
+            }
+        }
+
+        return Quest::SeqErrorCodes::UnsupportedExtension;
+    }
+}
+
+// OpenCV only reads the variable the first time an EXR is touched, so it has to be set before then
+void Quest::EnableOpenExr() {
+    setenv("OPENCV_IO_ENABLE_OPENEXR", "1", 0);
+}
+
+bool Quest::HasFramePadding(const std::filesystem::path& file_path) {
+    std::string path_string = file_path;
+    const std::regex padding_pattern(R"(%\d\dd)");
+    std::smatch matches, matches_2;
+    if (std::regex_search(path_string, matches, padding_pattern)) {
+        std::string suffix_string = matches.suffix();
+        if (std::regex_search(suffix_string, matches_2, padding_pattern)) {
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+Quest::SeqPath::SeqPath(const std::filesystem::path& new_input_path, const int first_frame) {
+    std::string path_string = new_input_path;
+    const std::regex padding_pattern(R"(%\d\dd)");
+    std::smatch matches, matches_2;
+    if (std::regex_search(path_string, matches, padding_pattern)) {
+        std::string suffix_string = matches.suffix();
+        if (std::regex_search(suffix_string, matches_2, padding_pattern)) {
+            throw SeqException("More than one frame padding pattern specified");
+        }
+        input_path = new_input_path;
+        pre_frame = matches.prefix();
+        current_frame = first_frame;
+        post_frame = matches.suffix();
+
+        std::string padding_str = matches[0];
+        padding = std::stoi(matches[0].str().substr(1, 2));
+    } else {
+        throw SeqException("No frame padding set in input path");
+    }
+}
+
+std::string Quest::SeqPath::outputPath() const {
+    std::stringstream ss;
+    ss << pre_frame << std::setfill('0') << std::setw(padding) << current_frame << post_frame;
+    return ss.str();
+}
+
+std::string Quest::SeqPath::outputIncrement() {
+    std::string output = outputPath();
+    ++current_frame;
+    return output;
+}
+
+struct Quest::FramePool::State {
+    std::mutex mutex;
+    std::map<std::tuple<int, int, int>, std::vector<void*>> free_buffers; // Keyed by rows, cols and type
+    size_t max_cached_bytes;
+    Stats stats;
+
+    explicit State(const size_t new_max_cached_bytes) : max_cached_bytes(new_max_cached_bytes) {}
+
+    ~State() {
+        for (auto& [key, buffers] : free_buffers) {
+            for (void* buffer : buffers) std::free(buffer);
+        }
+    }
+};
+
+Quest::FramePool::FramePool(const size_t max_cached_bytes) : state(std::make_shared<State>(max_cached_bytes)) {}
+
+Quest::FramePool::Stats Quest::FramePool::get_stats() const {
+    std::lock_guard lock(state->mutex);
+    return state->stats;
+}
+
+void Quest::FramePool::reset_stats() {
+    std::lock_guard lock(state->mutex);
+    state->stats.hits = 0;
+    state->stats.misses = 0;
+}
+
+cv::Mat Quest::FramePool::acquire(const int rows, const int cols, const int type) {
+    if (rows <= 0 || cols <= 0) return {};
+    const size_t step = static_cast<size_t>(cols) * CV_ELEM_SIZE(type);
+    const size_t bytes = step * rows;
+    const std::tuple key(rows, cols, type);
+
+    void* buffer = nullptr;
+    {
+        std::lock_guard lock(state->mutex);
+        std::vector<void*>& free_buffers = state->free_buffers[key];
+        if (!free_buffers.empty()) {
+            buffer = free_buffers.back();
+            free_buffers.pop_back();
+            state->stats.cached_bytes -= bytes;
+            state->stats.hits++;
+        } else {
+            state->stats.misses++;
+        }
+    }
+    if (!buffer) {
+        buffer = std::aligned_alloc(64, (bytes + 63) / 64 * 64);
+        if (!buffer) throw std::bad_alloc();
+    }
+
+    // The buffer goes back to the pool instead of being freed once the last Mat sharing it lets go. The deleter
+    // keeps the pool's state alive, so Mats can safely outlive the FramePool they came from
+    std::shared_ptr<void> owner(buffer, [pool_state = state, key, bytes](void* returned) {
+        std::lock_guard lock(pool_state->mutex);
+        if (pool_state->stats.cached_bytes + bytes > pool_state->max_cached_bytes) {
+            std::free(returned);
+            return;
+        }
+        pool_state->free_buffers[key].push_back(returned);
+        pool_state->stats.cached_bytes += bytes;
+    });
+    return WrapSharedBuffer(rows, cols, type, buffer, step, std::move(owner));
+}
+
+void Quest::FramePool::clear() {
+    std::lock_guard lock(state->mutex);
+    for (auto& [key, buffers] : state->free_buffers) {
+        for (void* buffer : buffers) std::free(buffer);
+    }
+    state->free_buffers.clear();
+    state->stats.cached_bytes = 0;
+}
+
+// Never destroyed, like the shared buffer allocator, so static Mats can still return buffers during shutdown
+Quest::FramePool& Quest::FramePool::global() {
+    static auto* pool = new FramePool();
+    return *pool;
+}
+
+struct Quest::ThreadPool::State {
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    int requested_threads = 0;
+    std::atomic<int> thread_count = 1;
+    // Threads outside the pool hold it shared while they use the queues, and a resize holds it exclusively
+    std::shared_mutex resize_mutex;
+    std::vector<std::unique_ptr<TaskQueue>> queues; // One per worker
+    std::vector<std::thread> workers;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending = 0;
+    bool stopping = false;
+    std::atomic<size_t> next_queue = 0; // Spreads tasks queued from outside the pool over the workers
+    std::atomic<size_t> tasks_run = 0;
+    std::atomic<size_t> tasks_stolen = 0;
+
+    // Run one task, from the front of queue home if it has any and otherwise from the back of another queue
+    bool run_one(const size_t home, const bool is_worker) {
+        const size_t queue_count = queues.size();
+        for (size_t k = 0; k < queue_count; k++) {
+            TaskQueue& queue = *queues[(home + k) % queue_count];
+            std::function<void()> task;
+            {
+                std::lock_guard lock(queue.mutex);
+                if (queue.tasks.empty()) continue;
+                if (k == 0) {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                } else {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+            }
+            --pending;
+            if (k > 0 && is_worker) ++tasks_stolen;
+            task();
+            ++tasks_run;
+            return true;
+        }
+        return false;
+    }
+
+    void work(const size_t index) {
+        worker_pool = this;
+        worker_queue = index;
+        while (true) {
+            if (run_one(index, true)) continue;
+            std::unique_lock lock(wake_mutex);
+            wake.wait(lock, [this] { return stopping || pending > 0; });
+            if (stopping && pending == 0) return;
+        }
+    }
+
+    void start(const int new_requested_threads) {
+        requested_threads = new_requested_threads;
+        thread_count = ResolveThreadCount(requested_threads);
+        for (int w = 1; w < thread_count; w++) queues.push_back(std::make_unique<TaskQueue>());
+        for (size_t w = 0; w < queues.size(); w++) workers.emplace_back(&State::work, this, w);
+    }
+
+    // Workers only leave once every queued task has run
+    void stop() {
+        {
+            std::lock_guard lock(wake_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) worker.join();
+        workers.clear();
+        queues.clear();
+        stopping = false;
+    }
+
+    // Drains the queues and restarts the workers once no other thread is using the pool. Without a new thread count
+    // the pool is restarted at the one it was asked for, for a new cap to take effect
+    void restart(const std::optional<int> new_requested_threads) {
+        if (worker_pool == this || using_pool == this) {
+            throw Quest::SeqException("A ThreadPool can't be resized from one of its own tasks");
+        }
+        std::unique_lock lock(resize_mutex);
+        stop();
+        start(new_requested_threads.value_or(requested_threads));
+    }
+};
+
+namespace {
+    // Taken by threads from outside the pool for as long as they use its queues, so a resize waits for them and they
+    // wait for a resize. Workers don't need it since a resize drains their queues and joins them before going ahead
+    class PoolUse {
+        std::shared_lock<std::shared_mutex> lock;
+        const void* previous_pool = using_pool;
+
+    public:
+        PoolUse(const void* pool, std::shared_mutex& resize_mutex) {
+            if (worker_pool == pool || using_pool == pool) return;
+            lock = std::shared_lock(resize_mutex);
+            using_pool = pool;
+        }
+        PoolUse(const PoolUse&) = delete;
+        PoolUse& operator=(const PoolUse&) = delete;
+        ~PoolUse() { using_pool = previous_pool; }
+    };
+}
+
+// The global pool keeps at least the thread calling into it, so a reservation is granted what's left of the cap
+// after that and after the other reservations
+Quest::ThreadPool::Reservation::Reservation(const int count) : threads(std::max(1, count)) {
+    {
+        std::lock_guard lock(thread_limit_mutex);
+        if (MaxThreadsLocked() == 0) return;
+        threads = std::clamp(max_threads - 1 - reserved_threads, 1, threads);
+        reserved_threads += threads;
+        counted = true;
+    }
+    const State* global_state = global().state.get();
+    if (worker_pool != global_state && using_pool != global_state) global().state->restart(std::nullopt);
+}
+
+Quest::ThreadPool::Reservation::~Reservation() {
+    if (!counted) return;
+    {
+        std::lock_guard lock(thread_limit_mutex);
+        reserved_threads -= threads;
+    }
+    const State* global_state = global().state.get();
+    if (worker_pool != global_state && using_pool != global_state) global().state->restart(std::nullopt);
+}
+
+Quest::ThreadPool::ThreadPool(const int new_thread_count) : state(std::make_unique<State>()) {
+    state->start(new_thread_count);
+}
+
+Quest::ThreadPool::~ThreadPool() {
+    state->stop();
+}
+
+int Quest::ThreadPool::get_thread_count() const {
+    return state->thread_count;
+}
+
+void Quest::ThreadPool::set_thread_count(const int new_thread_count) {
+    state->restart(new_thread_count);
+}
+
+Quest::ThreadPool::Stats Quest::ThreadPool::get_stats() const {
+    return {state->tasks_run, state->tasks_stolen};
+}
+
+void Quest::ThreadPool::set_max_threads(const int new_max_threads) {
+    {
+        std::lock_guard lock(thread_limit_mutex);
+        max_threads = std::max(0, new_max_threads);
+        // Negative hands OpenCV back its default
+        const int opencv_threads = max_threads > 0 ? max_threads : -1;
+        if (parallel_regions > 0) {
+            saved_opencv_threads = opencv_threads;
+        } else {
+            cv::setNumThreads(opencv_threads);
+        }
+    }
+    global().state->restart(std::nullopt);
+}
+
+int Quest::ThreadPool::get_max_threads() {
+    std::lock_guard lock(thread_limit_mutex);
+    return MaxThreadsLocked();
+}
+
+void Quest::ThreadPool::set_limit_opencv_threads(const bool limit) {
+    std::lock_guard lock(thread_limit_mutex);
+    limit_opencv_threads = limit;
+}
+
+bool Quest::ThreadPool::get_limit_opencv_threads() {
+    std::lock_guard lock(thread_limit_mutex);
+    return limit_opencv_threads;
+}
+
+void Quest::ThreadPool::enqueue(std::function<void()> task) {
+    const PoolUse use(state.get(), state->resize_mutex);
+    if (state->queues.empty()) {
+        task();
+        ++state->tasks_run;
+        return;
+    }
+    // Tasks queued from a worker go on its own queue, where it will get to them first
+    const size_t index = worker_pool == state.get() ? worker_queue : state->next_queue++ % state->queues.size();
+    ++state->pending; // Counted first so a worker taking the task straight away can't see pending drop below it
+    {
+        State::TaskQueue& queue = *state->queues[index];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard lock(state->wake_mutex);
+    }
+    state->wake.notify_one();
+}
+
+bool Quest::ThreadPool::run_pending_task() {
+    const PoolUse use(state.get(), state->resize_mutex);
+    if (state->queues.empty()) return false;
+    const bool is_worker = worker_pool == state.get();
+    return state->run_one(is_worker ? worker_queue : state->next_queue++ % state->queues.size(), is_worker);
+}
+
+void Quest::ThreadPool::parallel_for(const int count, const std::function<void(int)>& fn, const int max_workers) {
+    const PoolUse use(state.get(), state->resize_mutex);
+    int workers = std::min(count, state->thread_count.load());
+    if (max_workers > 0) workers = std::min(workers, max_workers);
+    if (workers <= 1) {
+        for (int i = 0; i < count; i++) fn(i);
+        return;
+    }
+
+    // Shared with the helper tasks, which can start after the loop has finished. Those return without touching
+    // fn, so the caller only has to wait for the helpers that are already running
+    struct Loop {
+        const std::function<void(int)>* fn;
+        int count;
+        std::atomic<int> next = 0;
+        std::mutex mutex;
+        std::condition_variable helpers_finished;
+        int running_helpers = 0;
+        bool done = false;
+        std::exception_ptr error;
+
+        void run() {
+            try {
+                for (int i = next++; i < count; i = next++) (*fn)(i);
+            } catch (...) {
+                next = count;
+                std::lock_guard lock(mutex);
+                if (!error) error = std::current_exception();
+            }
+        }
+    };
+    const auto loop = std::make_shared<Loop>();
+    loop->fn = &fn;
+    loop->count = count;
+
+    const OpenCvThreadLimit opencv_limit(true);
+    for (int w = 1; w < workers; w++) {
+        enqueue([loop] {
+            {
+                std::lock_guard lock(loop->mutex);
+                if (loop->done) return;
+                loop->running_helpers++;
+            }
+            loop->run();
+            std::lock_guard lock(loop->mutex);
+            if (--loop->running_helpers == 0) loop->helpers_finished.notify_all();
+        });
+    }
+    loop->run();
+
+    std::unique_lock lock(loop->mutex);
+    loop->done = true;
+    loop->helpers_finished.wait(lock, [&loop] { return loop->running_helpers == 0; });
+    if (loop->error) std::rethrow_exception(loop->error);
+}
+
+// Never destroyed, like the frame pool, so its workers are still there for anything running during shutdown
+Quest::ThreadPool& Quest::ThreadPool::global() {
+    static auto* pool = new ThreadPool();
+    return *pool;
+}
+
+Quest::SeqContainer::~SeqContainer() {
+    if (fd >= 0) ::close(fd);
+}
+
+Quest::SeqErrorCodes Quest::SeqContainer::open(const std::filesystem::path& container_path) {
+    if (fd >= 0) ::close(fd);
+    index.clear();
+    fps = -1;
+
+    fd = ::open(container_path.c_str(), O_RDONLY);
+    if (fd < 0) return SeqErrorCodes::BadPath;
+
+    struct stat file_stat {};
+    ContainerFooter footer {};
+    const bool read_footer = fstat(fd, &file_stat) == 0
+        && static_cast<size_t>(file_stat.st_size) >= container_alignment + sizeof(footer)
+        && ReadFully(fd, &footer, sizeof(footer), file_stat.st_size - static_cast<off_t>(sizeof(footer)));
+    const uint64_t index_bytes = footer.frame_count * sizeof(ContainerIndexEntry);
+    if (!read_footer || std::memcmp(footer.magic, container_magic, sizeof(container_magic)) != 0
+        || footer.version != container_version
+        || footer.index_offset + index_bytes + sizeof(footer) != static_cast<uint64_t>(file_stat.st_size)) {
+        ::close(fd);
+        fd = -1;
+        return SeqErrorCodes::BadPath;
+    }
+
+    index.resize(footer.frame_count);
+    if (!ReadFully(fd, index.data(), index_bytes, static_cast<off_t>(footer.index_offset))) {
+        index.clear();
+        ::close(fd);
+        fd = -1;
+        return SeqErrorCodes::BadPath;
+    }
+    for (ContainerIndexEntry& entry : index) {
+        entry.codec[sizeof(entry.codec) - 1] = '\0';
+        if (entry.offset + entry.size > footer.index_offset || entry.rows <= 0 || entry.cols <= 0
+            || (entry.codec[0] == '\0' && entry.size < static_cast<uint64_t>(entry.step) * entry.rows)) {
+            index.clear();
+            ::close(fd);
+            fd = -1;
+            return SeqErrorCodes::BadPath;
+        }
+    }
+    fps = footer.fps;
+    return SeqErrorCodes::Success;
+}
+
+cv::Mat Quest::SeqContainer::read_frame(const int& i) const {
+    if (i < 0 || i >= get_frame_count()) {
+        throw std::out_of_range("Attempting to read a frame in SeqContainer that doesn't exist");
+    }
+    const ContainerIndexEntry& entry = index[i];
+
+    // Tightly packed raw frames are read straight into the Mat's buffer
+    if (entry.codec[0] == '\0' && entry.step == static_cast<uint32_t>(entry.cols * CV_ELEM_SIZE(entry.type))) {
+        cv::Mat frame(entry.rows, entry.cols, entry.type);
+        if (!ReadFully(fd, frame.data, static_cast<size_t>(entry.step) * entry.rows, static_cast<off_t>(entry.offset))) {
+            return {};
+        }
+        return frame;
+    }
+
+    std::vector<uchar> bytes(entry.size);
+    if (!ReadFully(fd, bytes.data(), bytes.size(), static_cast<off_t>(entry.offset))) return {};
+    return DecodeContainerFrame(entry, bytes.data(), nullptr);
+}
+
+// Unlinked scratch file that frames over a sequence's memory budget are written out to, one page aligned slot per
+// frame. Spilled frames are mapped back in from it when they're accessed
+struct Quest::ImageSeq::SpillFile {
+    struct Slot {
+        off_t offset = -1;
+        size_t capacity = 0;
+        int rows = 0;
+        int cols = 0;
+        int type = 0;
+        bool written = false; // False once the frame has changed since it was last written
+    };
+
+    int fd = -1;
+    off_t size = 0;
+    std::vector<Slot> slots;
+    mutable std::mutex mutex; // Guards size and slots
+
+    SpillFile(const std::filesystem::path& directory, const size_t frame_count) : slots(frame_count) {
+        std::error_code error;
+        const std::filesystem::path scratch = directory.empty() ? std::filesystem::temp_directory_path(error) : directory;
+        // No usable temp directory leaves the file invalid rather than spilling somewhere unexpected
+        if (error || scratch.empty()) return;
+        std::string path = (scratch / "quest_spill_XXXXXX").string();
+        fd = mkstemp(path.data());
+        // Unlinked straight away so nothing is left behind, even if the process dies
+        if (fd >= 0) unlink(path.c_str());
+    }
+
+    ~SpillFile() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    [[nodiscard]] bool valid() const { return fd >= 0; }
+
+    [[nodiscard]] bool holds(const int i) const {
+        std::lock_guard lock(mutex);
+        return slots[i].written;
+    }
+
+    void forget(const int i) {
+        std::lock_guard lock(mutex);
+        slots[i].written = false;
+    }
+
+    // Write a frame to its slot, moving it to a bigger one at the end of the file if it has outgrown it
+    bool write(const int i, const cv::Mat& frame) {
+        const size_t row_bytes = frame.cols * frame.elemSize();
+        const size_t bytes = row_bytes * frame.rows;
+        Slot slot;
+        {
+            std::lock_guard lock(mutex);
+            slot = slots[i];
+            if (slot.offset < 0 || slot.capacity < bytes) {
+                const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+                slot.capacity = (bytes + page_size - 1) / page_size * page_size;
+                slot.offset = size;
+                size += static_cast<off_t>(slot.capacity);
+            }
+        }
+
+        bool written = true;
+        if (frame.isContinuous()) {
+            written = WriteFully(fd, frame.data, bytes, slot.offset);
+        } else {
+            for (int y = 0; y < frame.rows && written; y++) {
+                written = WriteFully(fd, frame.ptr(y), row_bytes, slot.offset + static_cast<off_t>(row_bytes * y));
+            }
+        }
+        if (!written) return false;
+
+        std::lock_guard lock(mutex);
+        slot.rows = frame.rows;
+        slot.cols = frame.cols;
+        slot.type = frame.type();
+        slot.written = true;
+        slots[i] = slot;
+        return true;
+    }
+
+    // Map a spilled frame back in. Pages come in from the page cache as they're touched and changes stay private
+    [[nodiscard]] cv::Mat read(const int i) const {
+        Slot slot;
+        {
+            std::lock_guard lock(mutex);
+            slot = slots[i];
+        }
+        if (slot.offset < 0) return {};
+        auto mapping = std::make_shared<MappedFile>(fd, slot.offset, slot.capacity);
+        if (!mapping->valid()) return {};
+        return WrapSharedBuffer(slot.rows, slot.cols, slot.type, mapping->bytes(),
+            static_cast<size_t>(slot.cols) * CV_ELEM_SIZE(slot.type), mapping);
+    }
+};
+
+Quest::ImageSeq::ImageSeq(const ImageSeq& original) {
+    Copy(original, *this);
+}
+
+Quest::ImageSeq::~ImageSeq() {
+    finish_prefetches();
+}
+
+Quest::SeqErrorCodes Quest::ImageSeq::open(const std::filesystem::path& new_input_path,
+    const ProgressCallback& progress, const CancelToken& cancel) {
+    try {
+        const SeqErrorCodes result = open_frames(new_input_path, progress, cancel);
+        // Render numbers frames from 1, so the files of a sequence numbered from 0 aren't the ones it would write
+        const bool numbered_from_zero = HasFramePadding(new_input_path) &&
+            std::filesystem::exists(SeqPath(new_input_path, 0).outputPath());
+        if (result == SeqErrorCodes::Success) {
+            mark_clean(numbered_from_zero ? std::filesystem::path() : new_input_path, std::nullopt);
+        }
+        return result;
+    } catch (const OperationCancelled&) {
+        return SeqErrorCodes::Cancelled;
+    }
+}
+
+Quest::SeqErrorCodes Quest::ImageSeq::open(const std::vector<std::vector<uchar>>& encoded_frames,
+    const ProgressCallback& progress, const CancelToken& cancel) {
+    try {
+        const SeqErrorCodes result = open_frames(std::filesystem::path(), progress, cancel, &encoded_frames);
+        if (result == SeqErrorCodes::Success) mark_clean(std::filesystem::path(), std::nullopt);
+        return result;
+    } catch (const OperationCancelled&) {
+        return SeqErrorCodes::Cancelled;
+    }
+}
+
+std::future<Quest::SeqErrorCodes> Quest::ImageSeq::open_async(const std::filesystem::path& new_input_path,
+    const ProgressCallback& progress, const CancelToken& cancel) {
+    return std::async(std::launch::async, [this, new_input_path, progress, cancel] {
+        const ThreadPool::Reservation reservation;
+        return open(new_input_path, progress, cancel);
+    });
+}
+
+// Frames are decoded off to the side and only swapped in once every one of them has been, so a failed or cancelled
+// open leaves the sequence as it was
+Quest::SeqErrorCodes Quest::ImageSeq::open_frames(const std::filesystem::path& new_input_path,
+    const ProgressCallback& progress, const CancelToken& cancel,
+    const std::vector<std::vector<uchar>>* encoded_frames) {
+    cv::VideoCapture input_video;
+    FrameFileReader read_frame = nullptr;
+    const InputType type = encoded_frames ? InputType::Encoded : DetectInputType(new_input_path, &read_frame);
+    cv::Mat new_arena;
+
+    // With compressed storage frames are compressed as soon as they're decoded, so the whole sequence is never held
+    // decoded at once. Arenas would only hold the few frames that can't be compressed, so they're skipped
+    // With a memory budget, frames decoded once the budget is used up go straight to a new spill file
+    const bool compress = storage == FrameStorage::Compressed;
+    const bool spill = storage == FrameStorage::Decoded && memory_budget > 0;
+    const bool use_arena = allocation != FrameAllocation::PerFrame && !compress && !spill;
+    std::vector<cv::Mat> new_frames;
+    std::vector<uint64_t> new_checksums;
+    std::vector<std::vector<uchar>> new_compressed;
+    std::shared_ptr<SpillFile> new_spill_file;
+    std::mutex budget_mutex;
+    size_t decoded_bytes = 0;
+    ProgressCounter counter(progress);
+    std::vector<char> frame_counted; // A video decoded again serially after a failed parallel decode stores frames twice
+    const FrameStore store = [&](const int i, const cv::Mat& decoded) {
+        if (cancel.is_cancelled()) throw OperationCancelled();
+        if (!decoded.empty() && !std::exchange(frame_counted[i], 1)) counter.frame_done();
+        new_checksums[i] = decoded.empty() ? 0 : FrameChecksum(decoded);
+        if (compress) {
+            new_compressed[i] = CompressFrame(decoded);
+            if (!new_compressed[i].empty()) {
+                new_frames[i].release();
+                return;
+            }
+        }
+        if (new_spill_file && !decoded.empty()) {
+            std::unique_lock lock(budget_mutex);
+            if (decoded_bytes + FrameBytes(decoded) > memory_budget) {
+                lock.unlock();
+                if (new_spill_file->write(i, decoded)) {
+                    new_frames[i].release();
+                    return;
+                }
+                lock.lock();
+            }
+            decoded_bytes += FrameBytes(decoded);
+        }
+        StoreFrame(new_frames[i], decoded);
+    };
+    const auto prepare_frames = [&](const int count) {
+        counter.total = count;
+        frame_counted.assign(count, 0);
+        new_frames.resize(count);
+        new_checksums.resize(count);
+        new_compressed.resize(count);
+        if (spill) {
+            new_spill_file = std::make_shared<SpillFile>(scratch_directory, count);
+            if (!new_spill_file->valid()) new_spill_file.reset(); // No scratch space, so frames stay in memory
+        }
+    };
+    const auto missing_frame = [&] {
+        for (size_t i = 0; i < new_frames.size(); i++) {
+            if (new_frames[i].empty() && new_compressed[i].empty() && !(new_spill_file && new_spill_file->holds(i))) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    // Lazy sequences only note where each frame is, reading the first one for the dimensions
+    // Encoded frames belong to the caller, so they're decoded in full like a video
+    if (storage == FrameStorage::Lazy && type != InputType::Video && type != InputType::Encoded &&
+        type != InputType::Unsupported) {
+        std::function<cv::Mat(int)> new_read_source_frame;
+        int new_frame_count = 0;
+        double new_fps = fps;
+        if (type == InputType::Container) {
+            const auto container = std::make_shared<SeqContainer>();
+            if (container->open(new_input_path) != SeqErrorCodes::Success) {
+                return SeqErrorCodes::BadPath;
+            }
+            new_frame_count = container->get_frame_count();
+            new_fps = container->get_fps();
+            new_read_source_frame = [container](const int i) { return container->read_frame(i); };
+        } else {
+            auto frame_paths = std::make_shared<std::vector<std::string>>();
+            if (type == InputType::Image) {
+                frame_paths->push_back(new_input_path);
+            } else {
+                *frame_paths = SequenceFramePaths(new_input_path);
+            }
+            new_frame_count = static_cast<int>(frame_paths->size());
+            new_read_source_frame = [frame_paths, read_frame](const int i) { return read_frame((*frame_paths)[i]); };
+        }
+        const cv::Mat first = new_frame_count > 0 ? new_read_source_frame(0) : cv::Mat();
+        if (first.empty()) {
+            return SeqErrorCodes::BadPath;
+        }
+
+        finish_prefetches();
+        std::lock_guard lock(cache_mutex);
+        input_path = new_input_path;
+        arena.release();
+        frame_count = new_frame_count;
+        width = first.cols;
+        height = first.rows;
+        fps = new_fps;
+        frames.assign(frame_count, cv::Mat());
+        frames[0] = first;
+        dirty_frames.assign(frame_count, FrameChange::Clean);
+        compressed_frames.clear();
+        frame_checksums.assign(frame_count, 0);
+        frame_checksums[0] = FrameChecksum(first);
+        clean_checksums.assign(frame_count, 0);
+        clean_checksums[0] = frame_checksums[0];
+        hot_frames.assign(1, 0);
+        spill_file.reset();
+        read_source_frame = std::move(new_read_source_frame);
+        prefetch_state.assign(frame_count, PrefetchState::Idle);
+        last_accessed = -1;
+        if (progress) progress(frame_count, frame_count);
+        return SeqErrorCodes::Success;
+    }
+
+    // The count is only stored once every frame has been, so a failed or cancelled open leaves it as it was
+    int new_frame_count = 0;
+
+    // Check if it's a video container
+    if (type == InputType::Video) {
+        input_video.open(new_input_path);
+        if (!input_video.isOpened()) {
+            return SeqErrorCodes::BadPath;
+        }
+        new_frame_count = static_cast<int>(input_video.get(cv::CAP_PROP_FRAME_COUNT));
+    }
+
+    // Handle each type or return as unsupported if type can be determined
+    switch (type) {
+    case InputType::Video: {
+        prepare_frames(new_frame_count);
+        cv::Size frame_size;
+        int first_frame = 0;
+        if (use_arena && new_frame_count > 0) {
+            // Decode the first frame up front so the arena can be sized from it
+            cv::Mat first;
+            if (!ReadVideoFrame(input_video, first, frame_size)) {
+                return SeqErrorCodes::BadPath;
+            }
+            new_arena = AllocateFrameArena(new_frames, first.rows, first.cols, first.type(),
+                allocation == FrameAllocation::HugePageArena);
+            store(0, first);
+            first_frame = 1;
+        }
+        if (!DecodeVideoParallel(new_input_path, new_frame_count, first_frame, store)) {
+            for (int i = first_frame; i < new_frame_count; i++) {
+                cv::Mat decoded;
+                if (!ReadVideoFrame(input_video, decoded, frame_size)) {
+                    for (int j = i; j < new_frame_count; j++) store(j, cv::Mat());
+                    break;
+                }
+                store(i, decoded);
+            }
+        }
+    } break;
+    case InputType::Image: {
+        // SINGULAR IMAGE - NO FRAME PADDING
+        cv::Mat img = read_frame(new_input_path);
+        if (img.empty()) {
+            return SeqErrorCodes::BadPath;
+        }
+        prepare_frames(1);
+        store(0, img);
+        new_frame_count = 1;
+    } break;
+    case InputType::ImageSequence: {
+        // IMAGE SEQUENCE - frames are found on disk from frame 0 or 1, then decoded in parallel
+        const std::vector<std::string> frame_paths = SequenceFramePaths(new_input_path);
+        const auto sequence_frames = static_cast<int>(frame_paths.size());
+        if (sequence_frames == 0) {
+            return SeqErrorCodes::BadPath;
+        }
+        // Every decoder hints a file a little way ahead of the one it's reading, keeping storage's queue full
+        const int read_ahead = ReadAheadFiles();
+        for (int i = 0; i < std::min(read_ahead, sequence_frames); i++) HintFileRead(frame_paths[i]);
+
+        prepare_frames(sequence_frames);
+        int first_frame = 0;
+        if (use_arena) {
+            // Decode the first frame up front so the arena can be sized from it
+            const cv::Mat first = read_frame(frame_paths[0]);
+            if (first.empty()) {
+                return SeqErrorCodes::BadPath;
+            }
+            new_arena = AllocateFrameArena(new_frames, first.rows, first.cols, first.type(),
+                allocation == FrameAllocation::HugePageArena);
+            store(0, first);
+            first_frame = 1;
+        }
+        ParallelFor(sequence_frames - first_frame, [&](const int i) {
+            const int ahead = first_frame + i + read_ahead;
+            if (ahead < sequence_frames) HintFileRead(frame_paths[ahead]);
+            store(first_frame + i, read_frame(frame_paths[first_frame + i]));
+        });
+        if (missing_frame()) {
+            return SeqErrorCodes::BadPath;
+        }
+        new_frame_count = sequence_frames;
+    } break;
+    case InputType::Container: {
+        // The index comes through the reader, then the whole file is mapped once so raw frames can share it
+        SeqContainer container;
+        if (container.open(new_input_path) != SeqErrorCodes::Success || container.get_frame_count() == 0) {
+            return SeqErrorCodes::BadPath;
+        }
+        const auto mapping = std::make_shared<MappedFile>(new_input_path);
+        if (!mapping->valid()) {
+            return SeqErrorCodes::BadPath;
+        }
+        // Raw frames are already contiguous in the mapping, so only encoded frames are decoded into an arena
+        prepare_frames(container.get_frame_count());
+        const ContainerIndexEntry& first = container.get_index_entry(0);
+        if (use_arena && first.codec[0] != '\0') {
+            new_arena = AllocateFrameArena(new_frames, first.rows, first.cols, first.type,
+                allocation == FrameAllocation::HugePageArena);
+        }
+        ParallelFor(container.get_frame_count(), [&](const int i) {
+            const ContainerIndexEntry& entry = container.get_index_entry(i);
+            store(i, DecodeContainerFrame(entry, mapping->bytes() + entry.offset, mapping));
+        });
+        if (missing_frame()) {
+            return SeqErrorCodes::BadPath;
+        }
+        new_frame_count = container.get_frame_count();
+        fps = container.get_fps();
+    } break;
+    case InputType::Encoded: {
+        // IN-MEMORY FRAME FILES - decoded in parallel like a sequence on disk
+        const int encoded_count = static_cast<int>(encoded_frames->size());
+        if (encoded_count == 0) {
+            return SeqErrorCodes::BadPath;
+        }
+        prepare_frames(encoded_count);
+        int first_frame = 0;
+        if (use_arena) {
+            // Decode the first frame up front so the arena can be sized from it
+            const cv::Mat first = DecodeFrameBytes((*encoded_frames)[0]);
+            if (first.empty()) {
+                return SeqErrorCodes::BadPath;
+            }
+            new_arena = AllocateFrameArena(new_frames, first.rows, first.cols, first.type(),
+                allocation == FrameAllocation::HugePageArena);
+            store(0, first);
+            first_frame = 1;
+        }
+        ParallelFor(encoded_count - first_frame, [&](const int i) {
+            store(first_frame + i, DecodeFrameBytes((*encoded_frames)[first_frame + i]));
+        });
+        if (missing_frame()) {
+            return SeqErrorCodes::BadPath;
+        }
+        new_frame_count = encoded_count;
+    } break;
+    default:
+        return Quest::SeqErrorCodes::UnsupportedExtension;
+    }
+
+    if (type == InputType::Video) {
+        fps = input_video.get(cv::CAP_PROP_FPS);
+    }
+
+    // Frame dimensions come from the first frame, decoding it again if it was compressed or spilled. A video whose
+    // first frame couldn't be decoded has none, and is left at 0 by 0 as before
+    cv::Mat first = new_frames[0];
+    if (first.empty() && !new_compressed[0].empty()) {
+        first = DecompressFrame(new_compressed[0]);
+    } else if (first.empty() && new_spill_file && new_spill_file->holds(0)) {
+        first = new_spill_file->read(0);
+    }
+    input_path = new_input_path;
+    arena = new_arena;
+    frame_count = new_frame_count;
+    width = first.cols;
+    height = first.rows;
+
+    finish_prefetches();
+    std::lock_guard lock(cache_mutex);
+    frames = std::move(new_frames);
+    dirty_frames.assign(frames.size(), FrameChange::Clean);
+    clean_checksums = std::move(new_checksums);
+    read_source_frame = nullptr;
+    prefetch_state.assign(frames.size(), PrefetchState::Idle);
+    last_accessed = -1;
+    compressed_frames = compress ? std::move(new_compressed) : std::vector<std::vector<uchar>>();
+    frame_checksums.assign(frames.size(), 0);
+    hot_frames.clear();
+    spill_file = new_spill_file;
+    if (spill_file) {
+        // Frames that stayed in memory are ordered least recently used first by frame number
+        for (int i = 0; i < static_cast<int>(frames.size()); i++) {
+            if (!frames[i].empty()) hot_frames.push_front(i);
+        }
+    }
+
+    return Quest::SeqErrorCodes::Success;
+}
+
+Quest::SeqErrorCodes Quest::ImageSeq::render(const std::filesystem::path& new_output_path,
+    const RenderOptions& options, const ProgressCallback& progress, const CancelToken& cancel) {
+    if (frames.empty()) {
+        throw SeqException("Attempting to render image sequence before images have been opened.");
+    }
+
+    // Progress counts frames as they're handed to the writer, or found not to need writing
+    ProgressCounter counter(progress);
+    counter.total = static_cast<int>(frames.size());
+
+    // Back at the clean path with matching options, only dirty frames need their files written again. Whether a
+    // resumed render skips frames doesn't change how they're encoded, and files that were opened are only known to
+    // match the default options
+    RenderOptions encoding = options;
+    encoding.resume = false;
+    const bool incremental = !clean_path.empty() && new_output_path == clean_path &&
+        clean_options.value_or(RenderOptions()) == encoding;
+    FrameFilter unchanged = nullptr;
+    if (incremental) {
+        unchanged = [&](const int i) {
+            if (is_dirty(i)) return false;
+            counter.frame_done();
+            return true;
+        };
+    }
+
+    // Frames left out as unchanged keep the checksums they have
+    std::vector<uint64_t> rendered_checksums(frames.size(), 0);
+    SeqErrorCodes result;
+    try {
+        result = RenderFrames(new_output_path, options, static_cast<int>(frames.size()), [&](const int i) {
+            if (cancel.is_cancelled()) throw OperationCancelled();
+            cv::Mat frame = get_frame(i);
+            rendered_checksums[i] = FrameChecksum(frame);
+            counter.frame_done();
+            return frame;
+        }, cv::Size(width, height), fps, unchanged);
+    } catch (const OperationCancelled&) {
+        return SeqErrorCodes::Cancelled;
+    }
+    if (result == SeqErrorCodes::Success) {
+        output_path = new_output_path;
+        mark_clean(new_output_path, encoding);
+        for (size_t i = 0; i < frames.size(); i++) {
+            if (rendered_checksums[i]) clean_checksums[i] = rendered_checksums[i];
+        }
+    }
+    return result;
+}
+
+void Quest::ImageSeq::mark_clean(const std::filesystem::path& new_clean_path,
+    const std::optional<RenderOptions>& options) {
+    clean_path = new_clean_path;
+    clean_options = options;
+    dirty_frames.assign(frames.size(), FrameChange::Clean);
+    clean_checksums.resize(frames.size(), 0);
+}
+
+bool Quest::ImageSeq::is_dirty(const int i) const {
+    if (dirty_frames[i] == FrameChange::Touched) {
+        return clean_checksums[i] == 0 || FrameChecksum(get_frame(i)) != clean_checksums[i];
+    }
+    return dirty_frames[i] == FrameChange::Changed;
+}
+
+int Quest::ImageSeq::get_dirty_frame_count() const {
+    int dirty = 0;
+    for (int i = 0; i < static_cast<int>(dirty_frames.size()); i++) {
+        if (is_dirty(i)) dirty++;
+    }
+    return dirty;
+}
+
+// Each frame is encoded straight into its own buffer, so frames encode in parallel with no ordering between them
+Quest::SeqErrorCodes Quest::ImageSeq::render(std::vector<std::vector<uchar>>& encoded_frames,
+    const std::string& extension, const RenderOptions& options, const ProgressCallback& progress,
+    const CancelToken& cancel) const {
+    if (frames.empty()) {
+        throw SeqException("Attempting to render image sequence before images have been opened.");
+    }
+    const std::vector<std::string>& extensions = supported_image_extensions;
+    if (extension != exr_extension && std::find(extensions.begin(), extensions.end(), extension) == extensions.end()) {
+        return SeqErrorCodes::UnsupportedExtension;
+    }
+
+    const std::vector<int> params = ImageWriteParams(extension, options);
+    std::vector<std::vector<uchar>> new_encoded_frames(frames.size());
+    ProgressCounter counter(progress);
+    counter.total = static_cast<int>(frames.size());
+    std::atomic<bool> encoded = true;
+    try {
+        ParallelFor(static_cast<int>(frames.size()), [&](const int i) {
+            if (cancel.is_cancelled()) throw OperationCancelled();
+            if (!EncodeFrameBytes(get_frame(i), extension, params, new_encoded_frames[i])) encoded = false;
+            counter.frame_done();
+        });
+    } catch (const OperationCancelled&) {
+        return SeqErrorCodes::Cancelled;
+    }
+    if (!encoded) return SeqErrorCodes::UnsupportedExtension; // OpenCV was built without this encoder
+    encoded_frames = std::move(new_encoded_frames);
+    return SeqErrorCodes::Success;
+}
+
+std::future<Quest::SeqErrorCodes> Quest::ImageSeq::render_async(const std::filesystem::path& new_output_path,
+    const RenderOptions& options, const ProgressCallback& progress, const CancelToken& cancel) {
+    return std::async(std::launch::async, [this, new_output_path, options, progress, cancel] {
+        const ThreadPool::Reservation reservation;
+        return render(new_output_path, options, progress, cancel);
+    });
+}
+
+// The frame could be changed through the reference, so a clean frame is marked Touched and compared against its
+// clean checksum when it's next rendered. Prefetches trim the hot frames from other threads, so with a cache the
+// frame is only looked at again under cache_mutex. It was made the most recently used, and lazy caches keep room for
+// a full prefetch window besides, so it's still decoded when it's handed out
+cv::Mat& Quest::ImageSeq::operator[] (const int& index) {
+    if (index >= frames.size() || index < 0) {
+        throw std::out_of_range("Attempting to access a frame in ImageSeq object that doesn't exist");
+    }
+    if (storage == FrameStorage::Decoded && !spill_file) {
+        if (dirty_frames[index] == FrameChange::Clean) dirty_frames[index] = FrameChange::Touched;
+        return frames[index];
+    }
+    load_frame(index);
+    if (storage == FrameStorage::Lazy) prefetch_after(index);
+    std::lock_guard lock(cache_mutex);
+    if (dirty_frames[index] == FrameChange::Clean) dirty_frames[index] = FrameChange::Touched;
+    return frames[index];
+}
+
+const cv::Mat& Quest::ImageSeq::operator[] (const int& index) const {
+    if (index >= frames.size() || index < 0) {
+        throw std::out_of_range("Attempting to access a frame in ImageSeq object that doesn't exist");
+    }
+    if (storage != FrameStorage::Decoded || spill_file) load_frame(index);
+    if (storage == FrameStorage::Lazy) prefetch_after(index);
+    return frames[index];
+}
+
+cv::Mat Quest::ImageSeq::get_frame(const int& i) const {
+    if (storage == FrameStorage::Decoded && !spill_file) return frames[i];
+    {
+        std::lock_guard lock(cache_mutex);
+        if (!frames[i].empty()) return frames[i];
+    }
+    // Decoded outside the lock so render threads decompress in parallel, and not added to the hot frames since a
+    // pass over the whole sequence would just churn them
+    if (storage == FrameStorage::Lazy) return read_source_frame ? read_source_frame(i) : cv::Mat();
+    return storage == FrameStorage::Compressed ? DecompressFrame(compressed_frames[i]) : spill_file->read(i);
+}
+
+void Quest::ImageSeq::set_frame(const int& i, const cv::Mat& new_frame) {
+    dirty_frames[i] = FrameChange::Changed;
+    if (storage == FrameStorage::Decoded && !spill_file) {
+        frames[i] = new_frame;
+        return;
+    }
+    if (storage == FrameStorage::Lazy) {
+        // Kept decoded from now on, since it can't be read back from the input
+        std::unique_lock lock(cache_mutex);
+        frame_read.wait(lock, [&] { return prefetch_state[i] != PrefetchState::Reading; });
+        const auto hot = std::find(hot_frames.begin(), hot_frames.end(), i);
+        if (hot != hot_frames.end()) hot_frames.erase(hot);
+        frames[i] = new_frame;
+        return;
+    }
+    std::vector<uchar> compressed = storage == FrameStorage::Compressed ? CompressFrame(new_frame) : std::vector<uchar>();
+    // A load still decoding the old frame would otherwise put it back over the new one
+    std::unique_lock lock(cache_mutex);
+    frame_read.wait(lock, [&] { return prefetch_state[i] != PrefetchState::Reading; });
+    const auto hot = std::find(hot_frames.begin(), hot_frames.end(), i);
+    if (hot != hot_frames.end()) hot_frames.erase(hot);
+    if (storage == FrameStorage::Compressed) {
+        frames[i] = compressed.empty() ? new_frame : cv::Mat();
+        compressed_frames[i] = std::move(compressed);
+        return;
+    }
+    frames[i] = new_frame;
+    spill_file->forget(i);
+    hot_frames.push_front(i);
+    trim_hot_frames();
 }
 
-Quest::SeqPath::SeqPath(const std::filesystem::path& new_input_path) {
-    std::string path_string = new_input_path;
-    const std::regex padding_pattern(R"(%\d\dd)");
-    std::smatch matches, matches_2;
-    if (std::regex_search(path_string, matches, padding_pattern)) {
-        std::string suffix_string = matches.suffix();
-        if (std::regex_search(suffix_string, matches_2, padding_pattern)) {
-            throw SeqException("More than one frame padding pattern specified");
+void Quest::ImageSeq::for_each_parallel(const std::function<void(cv::Mat&)>& fn, const int concurrency) {
+    // get_frame/set_frame rather than the frames themselves so compressed and spilled frames are stored back
+    ParallelFor(static_cast<int>(frames.size()), [&](const int i) {
+        cv::Mat frame = get_frame(i);
+        fn(frame);
+        set_frame(i, frame);
+    }, concurrency);
+    if (!frames.empty()) {
+        const cv::Mat first = get_frame(0);
+        width = first.cols;
+        height = first.rows;
+    }
+}
+
+Quest::ImageSeq Quest::ImageSeq::transform_parallel(const std::function<cv::Mat(const cv::Mat&)>& fn,
+    const int concurrency) const {
+    ImageSeq result;
+    result.input_path = input_path;
+    result.fps = fps;
+    result.frames.resize(frames.size());
+    ParallelFor(static_cast<int>(frames.size()), [&](const int i) {
+        result.frames[i] = fn(get_frame(i));
+    }, concurrency);
+    result.frame_count = static_cast<int>(result.frames.size());
+    if (!result.frames.empty()) {
+        result.width = result.frames[0].cols;
+        result.height = result.frames[0].rows;
+    }
+    result.mark_clean(std::filesystem::path(), std::nullopt);
+    return result;
+}
+
+size_t Quest::ImageSeq::get_resident_bytes() const {
+    std::lock_guard lock(cache_mutex);
+    size_t bytes = 0;
+    for (const cv::Mat& frame : frames) bytes += FrameBytes(frame);
+    return bytes;
+}
+
+void Quest::ImageSeq::set_storage(const FrameStorage& new_storage) {
+    if (new_storage == storage) return;
+    finish_prefetches();
+    std::lock_guard lock(cache_mutex);
+    const FrameStorage old_storage = storage;
+    storage = new_storage;
+    if (old_storage == FrameStorage::Lazy) {
+        // Frames only come back from the input while lazy, so every frame is read in first
+        if (read_source_frame) {
+            ParallelFor(static_cast<int>(frames.size()), [this](const int i) {
+                if (frames[i].empty()) frames[i] = read_source_frame(i);
+            });
         }
-        input_path = new_input_path;
-        pre_frame = matches.prefix();
-        current_frame = 1;
-        post_frame = matches.suffix();
+        read_source_frame = nullptr;
+        hot_frames.clear();
+        frame_checksums.assign(frames.size(), 0);
+        prefetch_state.assign(frames.size(), PrefetchState::Idle);
+        if (storage == FrameStorage::Compressed) {
+            compress_frames();
+        } else if (memory_budget > 0 && !frames.empty()) {
+            spill_file = std::make_shared<SpillFile>(scratch_directory, frames.size());
+            if (!spill_file->valid()) spill_file.reset();
+            for (int i = 0; spill_file && i < static_cast<int>(frames.size()); i++) hot_frames.push_front(i);
+            if (spill_file) trim_hot_frames();
+        }
+        return;
+    }
+    if (storage == FrameStorage::Compressed) {
+        compress_frames();
+        return;
+    }
+    if (storage == FrameStorage::Lazy) {
+        // Already opened frames are decoded and held until the next open, which is the first one read lazily
+        ParallelFor(static_cast<int>(frames.size()), [this](const int i) {
+            if (!frames[i].empty()) return;
+            frames[i] = compressed_frames.empty() ? spill_file->read(i) : DecompressFrame(compressed_frames[i]);
+        });
+        compressed_frames.clear();
+        spill_file.reset();
+        hot_frames.clear();
+        frame_checksums.assign(frames.size(), 0);
+        prefetch_state.assign(frames.size(), PrefetchState::Idle);
+        return;
+    }
 
-        std::string padding_str = matches[0];
-        padding = std::stoi(matches[0].str().substr(1, 2));
+    // Hot frames are already decoded and may have been changed, everything else is decoded from its compressed copy
+    if (memory_budget > 0) {
+        // One at a time, spilling as the budget fills up
+        spill_file = std::make_shared<SpillFile>(scratch_directory, frames.size());
+        if (!spill_file->valid()) spill_file.reset();
+    }
+    if (spill_file) {
+        hot_frames.clear();
+        for (int i = 0; i < static_cast<int>(frames.size()); i++) {
+            if (frames[i].empty()) frames[i] = DecompressFrame(compressed_frames[i]);
+            hot_frames.push_front(i);
+            trim_hot_frames();
+        }
     } else {
-        throw SeqException("No frame padding set in input path");
+        ParallelFor(static_cast<int>(frames.size()), [this](const int i) {
+            if (frames[i].empty() && !compressed_frames[i].empty()) frames[i] = DecompressFrame(compressed_frames[i]);
+        });
+        hot_frames.clear();
     }
+    compressed_frames.clear();
+    frame_checksums.assign(frames.size(), 0);
+    prefetch_state.assign(frames.size(), PrefetchState::Idle);
 }
 
-std::string Quest::SeqPath::outputPath() const {
-    std::stringstream ss;
-    ss << pre_frame << std::setfill('0') << std::setw(padding) << current_frame << post_frame;
-    return ss.str();
+void Quest::ImageSeq::set_memory_budget(const size_t& new_memory_budget) {
+    std::lock_guard lock(cache_mutex);
+    memory_budget = new_memory_budget;
+    if (storage != FrameStorage::Decoded || memory_budget == 0 || frames.empty()) return;
+    if (!spill_file) {
+        spill_file = std::make_shared<SpillFile>(scratch_directory, frames.size());
+        if (!spill_file->valid()) {
+            spill_file.reset();
+            return;
+        }
+        frame_checksums.assign(frames.size(), 0);
+        prefetch_state.assign(frames.size(), PrefetchState::Idle);
+        hot_frames.clear();
+        for (int i = 0; i < static_cast<int>(frames.size()); i++) hot_frames.push_front(i);
+    }
+    trim_hot_frames();
 }
 
-std::string Quest::SeqPath::outputIncrement() {
-    std::string output = outputPath();
-    ++current_frame;
-    return output;
+// Compress every frame, keeping the ones that can't be compressed decoded. Callers hold cache_mutex
+void Quest::ImageSeq::compress_frames() {
+    compressed_frames.assign(frames.size(), {});
+    frame_checksums.assign(frames.size(), 0);
+    prefetch_state.assign(frames.size(), PrefetchState::Idle);
+    hot_frames.clear();
+    ParallelFor(static_cast<int>(frames.size()), [this](const int i) {
+        if (frames[i].empty() && spill_file) frames[i] = spill_file->read(i);
+        compressed_frames[i] = CompressFrame(frames[i]);
+        if (!compressed_frames[i].empty()) frames[i].release();
+    });
+    spill_file.reset();
 }
 
-Quest::ImageSeq::ImageSeq(const ImageSeq& original) {
-    Copy(original, *this);
+// Make sure a frame is decoded and mark it the most recently used, then trim the hot frames. Like a prefetch, the
+// frame is marked Reading and read or decoded outside cache_mutex, so other frames can be served meanwhile
+void Quest::ImageSeq::load_frame(const int index) const {
+    std::unique_lock lock(cache_mutex);
+    const bool compressed = storage == FrameStorage::Compressed;
+    const bool lazy = storage == FrameStorage::Lazy;
+    if (compressed && compressed_frames[index].empty()) return; // Frames that can't be compressed are always decoded
+    if (lazy && !read_source_frame) return; // Nothing to read frames back from, so they're all decoded
+    // A frame already being read by a prefetch or another thread is waited for. One that's only queued is read here
+    // and the prefetch skips it
+    frame_read.wait(lock, [&] { return prefetch_state[index] != PrefetchState::Reading; });
+    prefetch_state[index] = PrefetchState::Idle;
+
+    const auto hot = std::find(hot_frames.begin(), hot_frames.end(), index);
+    if (hot != hot_frames.end()) {
+        hot_frames.erase(hot);
+    } else if (frames[index].empty()) {
+        prefetch_state[index] = PrefetchState::Reading;
+        lock.unlock();
+        cv::Mat read;
+        try {
+            if (lazy) read = read_source_frame(index);
+            else read = compressed ? DecompressFrame(compressed_frames[index]) : spill_file->read(index);
+        } catch (...) {
+            lock.lock();
+            prefetch_state[index] = PrefetchState::Idle;
+            frame_read.notify_all();
+            throw;
+        }
+        lock.lock();
+        prefetch_state[index] = PrefetchState::Idle;
+        frame_read.notify_all();
+        frames[index] = read;
+        frame_checksums[index] = FrameChecksum(read);
+        // Lazy frames are only read from the input while they still match it
+        if (lazy && clean_checksums[index] == 0) clean_checksums[index] = frame_checksums[index];
+    } else if (lazy) {
+        return; // Changed frames stay decoded outside the hot frames
+    }
+    hot_frames.push_front(index);
+    trim_hot_frames();
 }
 
-Quest::SeqErrorCodes Quest::ImageSeq::open(const std::filesystem::path& new_input_path) {
-    enum class InputTypes { ImageNoPadding, ImagePadding, ImageSequence, Video, Unsupported };
-    const std::string extension = new_input_path.extension();
-    cv::VideoCapture input_video;
-    InputTypes type = InputTypes::Unsupported;
-
-    // Determine type of input - starting with images (image sequence, singular image, singular image with frame padding)
-    // Also return as BadPath if the file can't be found
-    for (const std::string& image_extension : Quest::supported_image_extensions) {
-        if (extension == image_extension) {
-            // IMAGE SEQUENCE
-            if (Quest::HasFramePadding(new_input_path)) {
-                input_video.open(new_input_path, cv::CAP_IMAGES);
-                if (!input_video.isOpened()) {
-                    return SeqErrorCodes::BadPath;
-                }
-                frame_count = static_cast<int>(input_video.get(cv::CAP_PROP_FRAME_COUNT));
+// Push least recently used frames out until the hot frames fit, which is hot_cache_frames frames when compressed
+// and the memory budget when spilling. The most recent frame always stays. Frames that were changed while hot are
+// compressed or written again on their way out. Callers hold cache_mutex
+void Quest::ImageSeq::trim_hot_frames() const {
+    const bool compressed = storage == FrameStorage::Compressed;
+    const bool lazy = storage == FrameStorage::Lazy;
+    // Lazy caches always have room for the prefetched frames as well as the one being looked at
+    const int cache_frames = lazy ? std::max(hot_cache_frames, prefetch_window + 2) : hot_cache_frames;
+    size_t resident_bytes = 0;
+    if (!compressed && !lazy) {
+        for (const int i : hot_frames) resident_bytes += FrameBytes(frames[i]);
+    }
+    const auto over_budget = [&] {
+        if (compressed || lazy) return static_cast<int>(hot_frames.size()) > cache_frames;
+        return memory_budget > 0 && resident_bytes > memory_budget;
+    };
 
-                // Handling edge case of image sequence with just one frame
-                if (frame_count == 1) {
-                    type = InputTypes::ImagePadding;
-                } else {
-                    type = InputTypes::ImageSequence;
-                }
-            } else {
-                type = InputTypes::ImageNoPadding;
-            }
+    while (hot_frames.size() > 1 && over_budget()) {
+        const int evicted = hot_frames.back();
+        hot_frames.pop_back();
+        cv::Mat& frame = frames[evicted];
+        const bool changed = FrameChecksum(frame) != frame_checksums[evicted];
+        if (lazy) {
+            if (!changed) frame.release();
+            continue;
+        }
+        if (compressed) {
+            if (changed) compressed_frames[evicted] = CompressFrame(frame);
+            if (!compressed_frames[evicted].empty()) frame.release();
+            continue;
         }
+        // A frame that can't be written (out of scratch space) stays in memory as the least recently used hot frame,
+        // so it's counted and tried again next time. The other frames would most likely fail the same way
+        if ((changed || !spill_file->holds(evicted)) && !spill_file->write(evicted, frame)) {
+            hot_frames.push_back(evicted);
+            break;
+        }
+        resident_bytes -= FrameBytes(frame);
+        frame.release();
     }
+}
 
-    // Check if it's a video container
-    for (const std::string& video_extension : Quest::supported_video_extensions) {
-        if (extension == video_extension) {
-            input_video.open(new_input_path);
-            if (!input_video.isOpened()) {
-                return SeqErrorCodes::BadPath;
-            }
-            frame_count = static_cast<int>(input_video.get(cv::CAP_PROP_FRAME_COUNT));
-            type = InputTypes::Video;
+// Frames stepped through one at a time, either way, have the next prefetch_window frames in the same direction read on
+// the thread pool, so they're decoded by the time they're reached
+void Quest::ImageSeq::prefetch_after(const int index) const {
+    std::vector<int> upcoming;
+    {
+        std::lock_guard lock(cache_mutex);
+        const int step = index - last_accessed;
+        last_accessed = index;
+        if (!read_source_frame || (step != 1 && step != -1)) return;
+        for (int k = 1; k <= prefetch_window; k++) {
+            const int next = index + step * k;
+            if (next < 0 || next >= static_cast<int>(frames.size())) break;
+            if (!frames[next].empty() || prefetch_state[next] != PrefetchState::Idle) continue;
+            prefetch_state[next] = PrefetchState::Queued;
+            upcoming.push_back(next);
         }
+        std::erase_if(prefetch_tasks, [](const std::future<void>& task) {
+            return task.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        });
+    }
+    for (const int next : upcoming) {
+        std::future<void> task = ThreadPool::global().submit([this, next] { prefetch_frame(next); });
+        std::lock_guard lock(cache_mutex);
+        prefetch_tasks.push_back(std::move(task));
     }
+}
 
-    // Handle each type or return as unsupported if type can be determined
-    switch (type) {
-    case InputTypes::ImageNoPadding: {
-        // SINGULAR IMAGE - NO FRAME PADDING
-        cv::Mat img = cv::imread(new_input_path);
-        if (img.empty()) {
-            return SeqErrorCodes::BadPath;
+// Read a queued frame into the hot frames, unless it was read some other way first
+void Quest::ImageSeq::prefetch_frame(const int index) const {
+    {
+        std::lock_guard lock(cache_mutex);
+        if (prefetch_state[index] != PrefetchState::Queued) return;
+        prefetch_state[index] = PrefetchState::Reading;
+    }
+    cv::Mat read;
+    try {
+        read = read_source_frame(index);
+    } catch (const std::exception&) {
+        read.release(); // Left for operator[] to read, and fail, when the frame is reached
+    }
+    {
+        std::lock_guard lock(cache_mutex);
+        prefetch_state[index] = PrefetchState::Idle;
+        if (!read.empty() && frames[index].empty()) {
+            frames[index] = read;
+            frame_checksums[index] = FrameChecksum(read);
+            if (clean_checksums[index] == 0) clean_checksums[index] = frame_checksums[index];
+            hot_frames.push_front(index);
+            trim_hot_frames();
         }
-        frame_count = 1;
-        GiveMatPureWhiteAlpha(img);
-        frames.push_back(img);
-    } break;
-    case InputTypes::ImagePadding: {
-        const SeqPath input_seq(new_input_path);
-        frames.push_back(cv::imread(input_seq.outputPath()));
-        GiveMatPureWhiteAlpha(frames[0]);
-    } break;
-    case InputTypes::ImageSequence: case InputTypes::Video: {
-        frames.resize(frame_count);
-        for(int i = 0; i < input_video.get(cv::CAP_PROP_FRAME_COUNT); i++) {
-            input_video >> frames[i];
-            if (frames[i].rows > 0 && frames[i].cols > 0) GiveMatPureWhiteAlpha(frames[i]);
+    }
+    frame_read.notify_all();
+}
+
+// Wait for prefetches still using the sequence, dropping the ones that haven't started. Called without cache_mutex
+void Quest::ImageSeq::finish_prefetches() const {
+    std::vector<std::future<void>> tasks;
+    {
+        std::lock_guard lock(cache_mutex);
+        tasks = std::move(prefetch_tasks);
+        prefetch_tasks.clear();
+        std::replace(prefetch_state.begin(), prefetch_state.end(), PrefetchState::Queued, PrefetchState::Idle);
+    }
+    for (std::future<void>& task : tasks) ThreadPool::global().wait(task);
+}
+
+void Quest::Copy(const ImageSeq& original, ImageSeq& copy) {
+    if (&original == &copy) return;
+    copy.finish_prefetches();
+    std::scoped_lock lock(original.cache_mutex, copy.cache_mutex);
+    copy.input_path = original.input_path;
+    copy.output_path = original.output_path;
+    // The files at the original's clean path can change under the copy, through the original or anything else, so
+    // the copy's first render writes every frame
+    copy.clean_path.clear();
+    copy.clean_options.reset();
+    copy.dirty_frames = original.dirty_frames;
+    copy.clean_checksums = original.clean_checksums;
+    copy.frame_count = original.frame_count;
+    copy.width = original.width;
+    copy.height = original.height;
+
+    // Copies get frames of their own rather than views into the original's arena
+    copy.arena.release();
+    copy.frames.clear();
+    copy.frames.resize(original.frames.size());
+    for (size_t i = 0; i < original.frames.size(); i++) {
+        original.frames[i].copyTo(copy.frames[i]);
+    }
+
+    // Compressed frames are copied as they are, hot frames were copied above and keep their checksums
+    copy.storage = original.storage;
+    copy.hot_cache_frames = original.hot_cache_frames;
+    copy.compressed_frames = original.compressed_frames;
+    copy.frame_checksums = original.frame_checksums;
+    copy.hot_frames = original.hot_frames;
+
+    // Lazy copies read from the same input
+    copy.read_source_frame = original.read_source_frame;
+    copy.prefetch_window = original.prefetch_window;
+    copy.prefetch_state.assign(original.frames.size(), ImageSeq::PrefetchState::Idle);
+    copy.last_accessed = -1;
+
+    // Spilled frames are written again to a spill file of the copy's own. A frame that can't be written there is kept
+    // decoded instead, as the least recently used hot frame so it's spilled again once there's room
+    copy.memory_budget = original.memory_budget;
+    copy.scratch_directory = original.scratch_directory;
+    copy.spill_file.reset();
+    if (original.spill_file) {
+        auto spill_file = std::make_shared<ImageSeq::SpillFile>(copy.scratch_directory, original.frames.size());
+        if (!spill_file->valid()) {
+            spill_file.reset();
+            copy.hot_frames.clear();
         }
-    } break;
-    default:
-        return Quest::SeqErrorCodes::UnsupportedExtension;
+        for (int i = 0; i < static_cast<int>(original.frames.size()); i++) {
+            if (!copy.frames[i].empty()) continue;
+            const cv::Mat spilled = original.spill_file->read(i);
+            if (spill_file && spill_file->write(i, spilled)) continue;
+            spilled.copyTo(copy.frames[i]);
+            if (spill_file) copy.hot_frames.push_back(i);
+        }
+        copy.spill_file = std::move(spill_file);
     }
+}
 
-    if (type == InputTypes::Video) {
-        fps = input_video.get(cv::CAP_PROP_FPS);
+Quest::SeqView::SeqView(const ImageSeq& new_seq)
+    : seq(&new_seq), count(static_cast<int>(new_seq.end() - new_seq.begin())) {}
+
+const cv::Mat& Quest::SeqView::operator[](const int& index) const {
+    if (index >= count || index < 0) {
+        throw std::out_of_range("Attempting to access a frame in SeqView object that doesn't exist");
+    }
+    return (*seq)[get_source_index(index)];
+}
+
+Quest::SeqView Quest::SeqView::slice(const int first, const int last) const {
+    if (first < 0 || last > count || first > last) {
+        throw std::out_of_range("Attempting to slice frames outside of the SeqView");
     }
+    return {seq, get_source_index(first), step, last - first};
+}
 
-    input_path = new_input_path;
-    width = frames[0].cols;
-    height = frames[0].rows;
+Quest::SeqView Quest::SeqView::stride(const int n) const {
+    if (n < 1) {
+        throw SeqException("A SeqView stride must be at least 1");
+    }
+    return {seq, start, step * n, (count + n - 1) / n};
+}
 
-    return Quest::SeqErrorCodes::Success;
+Quest::SeqView Quest::SeqView::reversed() const {
+    if (count == 0) return *this;
+    return {seq, get_source_index(count - 1), -step, count};
 }
 
-Quest::SeqErrorCodes Quest::ImageSeq::render(const std::filesystem::path& new_output_path) {
-    if (frames.empty()) {
-        throw SeqException("Attempting to render image sequence before images have been opened.");
+Quest::SeqErrorCodes Quest::SeqView::render(const std::filesystem::path& output_path,
+    const RenderOptions& options) const {
+    if (count == 0) {
+        throw SeqException("Attempting to render an empty SeqView.");
     }
+    return RenderFrames(output_path, options, count, [this](const int i) { return get_frame(i); },
+        cv::Size(get_width(), get_height()), get_fps());
+}
 
-    if (!is_directory(new_output_path.parent_path())) {
-        return SeqErrorCodes::BadPath;
+void Quest::Timeline::append(const SeqView& view) {
+    std::lock_guard lock(mutex);
+    shot_starts.push_back(frame_count);
+    frame_count += view.get_frame_count();
+    shots.push_back({view, "", view.get_frame_count(), nullptr});
+}
+
+Quest::SeqErrorCodes Quest::Timeline::append(const std::filesystem::path& path) {
+    const std::optional<int> shot_frames = ProbeFrameCount(path);
+    if (!shot_frames) return SeqErrorCodes::UnsupportedExtension;
+    if (*shot_frames == 0) return SeqErrorCodes::BadPath;
+
+    std::lock_guard lock(mutex);
+    shot_starts.push_back(frame_count);
+    frame_count += *shot_frames;
+    shots.push_back({SeqView(), path, *shot_frames, nullptr});
+    return SeqErrorCodes::Success;
+}
+
+// Find the shot holding timeline frame i, opening it if it's a path that isn't open yet. Opening a shot closes the
+// least recently opened one once more than max_open_shots are open. Callers hold mutex
+const Quest::Timeline::Shot& Quest::Timeline::shot_at(const int i, int& shot_frame) const {
+    const auto shot_index = static_cast<int>(std::upper_bound(shot_starts.begin(), shot_starts.end(), i)
+        - shot_starts.begin()) - 1;
+    const Shot& shot = shots[shot_index];
+    shot_frame = i - shot_starts[shot_index];
+    if (shot.path.empty() || shot.opened) return shot;
+
+    auto opened = std::make_shared<ImageSeq>();
+    if (opened->open(shot.path) != SeqErrorCodes::Success) {
+        throw SeqException(("Failed to open timeline shot " + shot.path.string()).c_str());
+    }
+    // Frames were counted when the shot was appended, and the timeline can't shrink under frames already handed out
+    if (opened->get_frame_count() < shot.frame_count) {
+        throw SeqException(("Timeline shot " + shot.path.string() + " has " + std::to_string(opened->get_frame_count())
+            + " frames but had " + std::to_string(shot.frame_count) + " when it was appended").c_str());
     }
+    shot.opened = opened;
+    shot.view = SeqView(*opened).slice(0, shot.frame_count);
+    open_shots.push_front(shot_index);
+    while (static_cast<int>(open_shots.size()) > max_open_shots) {
+        const Shot& closed = shots[open_shots.back()];
+        open_shots.pop_back();
+        closed.view = SeqView();
+        closed.opened.reset();
+    }
+    return shot;
+}
 
-    const std::string extension = new_output_path.extension();
-    for (const std::string& valid : supported_image_extensions) {
-        if (extension == valid) {
-            if (HasFramePadding(new_output_path)) {
-                Quest::SeqPath output_seq(new_output_path);
-                output_path = new_output_path;
-                for (const cv::Mat& frame : frames) {
-                    std::filesystem::path frame_output_path = output_seq.outputIncrement();
-                    cv::imwrite(frame_output_path, frame);
-                }
-                return SeqErrorCodes::Success;
-            }
-            if (frame_count > 1) {
-                return SeqErrorCodes::BadPath;
-            }
-            output_path = new_output_path;
-            cv::imwrite(new_output_path, frames[0]);
-            return SeqErrorCodes::Success;
-        }
+cv::Mat Quest::Timeline::get_frame(const int& i) const {
+    // Only finding the shot needs the lock. Holding on to its sequence keeps it alive even if another thread closes
+    // the shot, so frames are fetched (and decoded, for compressed sequences) in parallel
+    SeqView view;
+    std::shared_ptr<ImageSeq> keep_open;
+    int shot_frame;
+    {
+        std::lock_guard lock(mutex);
+        const Shot& shot = shot_at(i, shot_frame);
+        view = shot.view;
+        keep_open = shot.opened;
+    }
+    return view.get_frame(shot_frame);
+}
+
+const cv::Mat& Quest::Timeline::operator[](const int& index) const {
+    if (index >= frame_count || index < 0) {
+        throw std::out_of_range("Attempting to access a frame in Timeline object that doesn't exist");
+    }
+    std::lock_guard lock(mutex);
+    int shot_frame;
+    const Shot& shot = shot_at(index, shot_frame);
+    return shot.view[shot_frame];
+}
+
+int Quest::Timeline::get_width() const {
+    return frame_count > 0 ? get_frame(0).cols : -1;
+}
+
+int Quest::Timeline::get_height() const {
+    return frame_count > 0 ? get_frame(0).rows : -1;
+}
+
+double Quest::Timeline::get_fps() const {
+    if (frame_count == 0) return -1;
+    std::lock_guard lock(mutex);
+    int shot_frame;
+    return shot_at(0, shot_frame).view.get_fps();
+}
+
+Quest::SeqErrorCodes Quest::Timeline::render(const std::filesystem::path& output_path,
+    const RenderOptions& options) const {
+    if (frame_count == 0) {
+        throw SeqException("Attempting to render an empty Timeline.");
     }
+    const cv::Mat first = get_frame(0);
+    return RenderFrames(output_path, options, frame_count, [this](const int i) { return get_frame(i); },
+        first.size(), get_fps());
+}
 
-    for (const std::string& video_extension : supported_video_extensions) {
-        if (extension == video_extension) {
-            cv::Size frame_size(width, height);
-            const double render_fps = fps == -1 ? default_fps : fps;
-            std::string codec;
-            if (extension == ".mp4" || extension == ".mov") codec = "H264";
+Quest::FrameRange::FrameRange(std::function<cv::Mat(int)> new_frame_at, const int new_count, const double new_fps)
+    : frame_at(std::move(new_frame_at)), count(std::max(0, new_count)), fps(new_fps) {}
 
-            cv::VideoWriter output_writer(new_output_path,
-                cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]),
-                render_fps, frame_size);
+Quest::FrameRange::FrameRange(const ImageSeq& seq) : FrameRange(SeqView(seq)) {}
 
-            for (const cv::Mat& frame : frames) {
-                output_writer.write(frame);
-            }
+Quest::FrameRange::FrameRange(const SeqView& view)
+    : FrameRange([view](const int i) { return view.get_frame(i); }, view.get_frame_count(), view.get_fps()) {}
 
-            output_path = new_output_path;
-            return SeqErrorCodes::Success;
-        }
+Quest::FrameRange::FrameRange(const Timeline& timeline)
+    : FrameRange([&timeline](const int i) { return timeline.get_frame(i); }, timeline.get_frame_count(),
+        timeline.get_fps()) {}
+
+cv::Mat Quest::FrameRange::operator[](const int& index) const {
+    if (index >= count || index < 0) {
+        throw std::out_of_range("Attempting to access a frame in FrameRange object that doesn't exist");
     }
+    return frame_at(index);
+}
 
-    return SeqErrorCodes::UnsupportedExtension;
+Quest::SeqErrorCodes Quest::FrameRange::render(const std::filesystem::path& output_path,
+    const RenderOptions& options) const {
+    if (count == 0) {
+        throw SeqException("Attempting to render an empty FrameRange.");
+    }
+    return RenderFrames(output_path, options, count, frame_at, frame_at(0).size(), fps);
 }
 
-cv::Mat& Quest::ImageSeq::operator[] (const int& index) {
-    if (index >= frames.size() || index < 0) {
-        throw std::out_of_range("Attempting to access a frame in ImageSeq object that doesn't exist");
+Quest::FrameRange Quest::views::operator|(const FrameRange& range, const FramesBetween& adaptor) {
+    if (adaptor.first < 0 || adaptor.last > range.get_frame_count() || adaptor.first > adaptor.last) {
+        throw std::out_of_range("Attempting to take frames outside of the FrameRange");
     }
-    return frames[index];
+    return {[range, first = adaptor.first](const int i) { return range.get_frame(first + i); },
+        adaptor.last - adaptor.first, range.get_fps()};
 }
 
-const cv::Mat& Quest::ImageSeq::operator[] (const int& index) const {
-    if (index >= frames.size() || index < 0) {
-        throw std::out_of_range("Attempting to access a frame in ImageSeq object that doesn't exist");
+Quest::FrameRange Quest::views::operator|(const FrameRange& range, const Stride& adaptor) {
+    if (adaptor.n < 1) {
+        throw SeqException("A FrameRange stride must be at least 1");
     }
-    return frames[index];
+    return {[range, n = adaptor.n](const int i) { return range.get_frame(i * n); },
+        (range.get_frame_count() + adaptor.n - 1) / adaptor.n, range.get_fps()};
 }
 
-Quest::ImageSeq& Quest::ImageSeq::operator=(const ImageSeq& original) {
-    Copy(original, *this);
+Quest::FrameRange Quest::views::operator|(const FrameRange& range, const Transform& adaptor) {
+    return {[range, fn = adaptor.fn](const int i) { return fn(range.get_frame(i)); },
+        range.get_frame_count(), range.get_fps()};
+}
+
+Quest::FrameRange Quest::views::operator|(const FrameRange& range, const Reverse&) {
+    return {[range, last = range.get_frame_count() - 1](const int i) { return range.get_frame(last - i); },
+        range.get_frame_count(), range.get_fps()};
+}
+
+Quest::Pipeline& Quest::Pipeline::add_stage(Stage fn, const std::string& name, const int threads) {
+    if (!fn) {
+        throw SeqException("Pipeline stages must be callable");
+    }
+    const std::string stage_name = name.empty() ? "stage " + std::to_string(stages.size() + 1) : name;
+    stages.push_back({stage_name, std::move(fn), std::max(1, threads)});
     return *this;
 }
 
-void Quest::Copy(const ImageSeq& original, ImageSeq& copy) {
-    copy.input_path = original.input_path;
-    copy.output_path = original.output_path;
-    copy.frame_count = original.frame_count;
-    copy.width = original.width;
-    copy.height = original.height;
+Quest::SeqErrorCodes Quest::Pipeline::run() {
+    using Clock = std::chrono::steady_clock;
+    using IndexedFrame = std::pair<int, cv::Mat>;
+    const Clock::time_point run_start = Clock::now();
 
-    copy.frames.resize(original.frame_count);
-    for (int i = 0; i < original.frame_count; i++) {
-        original.frames[i].copyTo(copy.frames[i]);
+    FrameSource source;
+    const SeqErrorCodes opened = source.open(source_path);
+    if (opened != SeqErrorCodes::Success) return opened;
+    if (!is_directory(sink_path.parent_path())) return SeqErrorCodes::BadPath;
+    const int frame_count = source.get_frame_count();
+    const auto stage_count = static_cast<int>(stages.size());
+
+    // Stage threads are counted against the process wide thread cap, shrinking the global pool the sink renders on
+    // while the run lasts. When they don't all fit, the stages with the most give threads up first, and when there
+    // are more stages than threads, neighbouring stages share one. The source is read by the first stages' threads
+    // and the sink takes its frames itself, so neither needs a thread of its own
+    int requested_threads = 0;
+    for (const StageInfo& stage : stages) requested_threads += stage.threads;
+    const ThreadPool::Reservation reservation(requested_threads);
+    const int stage_thread_budget = reservation.get_threads();
+
+    struct StageGroup {
+        int first; // Stages [first, last) run one after another on each of the group's threads
+        int last;
+        int threads;
+    };
+    std::vector<StageGroup> groups;
+    if (stage_thread_budget >= stage_count) {
+        std::vector<int> stage_threads(stage_count);
+        for (int s = 0; s < stage_count; s++) stage_threads[s] = stages[s].threads;
+        for (int total = requested_threads; total > stage_thread_budget; total--) {
+            --*std::max_element(stage_threads.begin(), stage_threads.end());
+        }
+        for (int s = 0; s < stage_count; s++) groups.push_back({s, s + 1, stage_threads[s]});
+    } else {
+        for (int g = 0; g < stage_thread_budget; g++) {
+            groups.push_back({g * stage_count / stage_thread_budget, (g + 1) * stage_count / stage_thread_budget, 1});
+        }
+    }
+    // Without any stages a single thread hands frames straight from the source to the sink
+    if (groups.empty()) groups.push_back({0, 0, 1});
+    const auto group_count = static_cast<int>(groups.size());
+
+    stats.assign(stage_count + 1, StageStats());
+    stats[0].name = "source";
+    for (const StageGroup& group : groups) {
+        for (int s = group.first; s < group.last; s++) {
+            stats[s + 1].name = stages[s].name;
+            stats[s + 1].threads = group.threads;
+        }
+    }
+    std::mutex stats_mutex;
+    const auto record = [&](const int s, const Clock::time_point start, const Clock::time_point done) {
+        const Clock::time_point pushed = Clock::now();
+        std::lock_guard lock(stats_mutex);
+        stats[s].frames++;
+        stats[s].busy_seconds += std::chrono::duration<double>(done - start).count();
+        stats[s].blocked_seconds += std::chrono::duration<double>(pushed - done).count();
+    };
+
+    // queues[g] holds what group g produced, and the last one feeds the sink
+    std::vector<std::unique_ptr<BoundedQueue<IndexedFrame>>> queues;
+    for (int g = 0; g < group_count; g++) {
+        queues.push_back(std::make_unique<BoundedQueue<IndexedFrame>>(queue_frames));
+    }
+
+    // Frames that made it through every stage wait here for the sink to ask for them. The source stays within
+    // window frames of the sink, which keeps this bounded while an early frame is held up in a stage with several
+    // threads, and leaves room for the sink to ask for a few frames at once
+    const int window = queue_frames * (group_count + 1) + 2 * ThreadPool::global().get_thread_count();
+    std::mutex sink_mutex;
+    std::condition_variable frame_finished;
+    std::condition_variable frame_delivered;
+    std::map<int, cv::Mat> finished_frames;
+    int delivered = 0;
+    bool stopped = false;
+    bool sink_popping = false; // One sink thread at a time waits on the last queue, the others on frame_finished
+    bool stages_drained = false;
+    bool source_failed = false;
+    int source_frames = frame_count; // Fewer than frame_count when a video runs out early
+    std::exception_ptr stage_error;
+
+    const auto stop = [&](const std::exception_ptr& error) {
+        {
+            std::lock_guard lock(sink_mutex);
+            if (error && !stage_error) stage_error = error;
+            stopped = true;
+        }
+        frame_finished.notify_all();
+        frame_delivered.notify_all();
+        for (const auto& queue : queues) queue->close();
+    };
+
+    // Frames are read one at a time and in order by whichever of the first group's threads gets there first
+    std::mutex source_mutex;
+    int next_read = 0;
+    const auto read_source = [&]() -> std::optional<IndexedFrame> {
+        std::lock_guard source_lock(source_mutex);
+        const int i = next_read;
+        if (i >= frame_count) return std::nullopt;
+        {
+            std::unique_lock lock(sink_mutex);
+            frame_delivered.wait(lock, [&] { return stopped || i < delivered + window; });
+            if (stopped) return std::nullopt;
+        }
+        const Clock::time_point start = Clock::now();
+        cv::Mat frame;
+        try {
+            frame = source.read();
+        } catch (const std::exception&) {
+            frame.release();
+        }
+        if (frame.empty() && source.get_frame_count() <= i) {
+            // A video that ran out early, which ends the sequence at the last frame read like open() does
+            next_read = frame_count;
+            {
+                std::lock_guard lock(sink_mutex);
+                source_frames = i;
+            }
+            frame_finished.notify_all();
+            return std::nullopt;
+        }
+        if (frame.empty()) {
+            {
+                std::lock_guard lock(sink_mutex);
+                source_failed = true;
+            }
+            stop(nullptr);
+            return std::nullopt;
+        }
+        next_read++;
+        const Clock::time_point done = Clock::now();
+        record(0, start, done);
+        return IndexedFrame {i, std::move(frame)};
+    };
+
+    const OpenCvThreadLimit opencv_limit(true);
+    std::vector<std::thread> threads;
+    std::vector<std::atomic<int>> running_threads(group_count);
+    for (int g = 0; g < group_count; g++) {
+        running_threads[g] = groups[g].threads;
+        for (int t = 0; t < groups[g].threads; t++) {
+            threads.emplace_back([&, g] {
+                const StageGroup& group = groups[g];
+                while (std::optional<IndexedFrame> next = g == 0 ? read_source() : queues[g - 1]->pop()) {
+                    bool failed = false;
+                    Clock::time_point start;
+                    Clock::time_point done;
+                    for (int s = group.first; s < group.last; s++) {
+                        // Only a group's last stage can be held up by the next, the others hand frames straight on
+                        if (s > group.first) record(s, start, done);
+                        start = Clock::now();
+                        try {
+                            next->second = stages[s].fn(next->second);
+                            if (next->second.empty()) {
+                                const std::string message =
+                                    "Pipeline stage " + stages[s].name + " returned an empty frame";
+                                throw SeqException(message.c_str());
+                            }
+                        } catch (...) {
+                            stop(std::current_exception());
+                            failed = true;
+                            break;
+                        }
+                        done = Clock::now();
+                    }
+                    if (failed) break;
+                    const bool pushed = queues[g]->push(std::move(*next));
+                    if (group.last > group.first) record(group.last, start, done);
+                    if (!pushed) break;
+                }
+                // The last of a group's threads to finish tells the next group there's nothing more coming
+                if (--running_threads[g] == 0) queues[g]->close();
+            });
+        }
+    }
+
+    // The sink asks for frames by index, possibly several at once, and waits for each to come out of the stages.
+    // Frames past the end of a video that ran out early come back empty, which the writers leave out
+    const auto take_frame = [&](const int i) {
+        std::unique_lock lock(sink_mutex);
+        while (!stopped && !stages_drained && !finished_frames.contains(i) && i < source_frames) {
+            if (sink_popping) {
+                frame_finished.wait(lock);
+                continue;
+            }
+            sink_popping = true;
+            lock.unlock();
+            std::optional<IndexedFrame> next = queues.back()->pop();
+            lock.lock();
+            sink_popping = false;
+            if (next) {
+                finished_frames.emplace(next->first, std::move(next->second));
+            } else {
+                stages_drained = true;
+            }
+            frame_finished.notify_all();
+        }
+        if (i >= source_frames) return cv::Mat();
+        const auto found = finished_frames.find(i);
+        if (found == finished_frames.end()) {
+            if (stage_error) std::rethrow_exception(stage_error);
+            throw SeqException("Pipeline stopped before every frame reached the sink");
+        }
+        cv::Mat frame = std::move(found->second);
+        finished_frames.erase(found);
+        delivered++;
+        lock.unlock();
+        frame_delivered.notify_all();
+        return frame;
+    };
+
+    SeqErrorCodes result = SeqErrorCodes::BadPath;
+    std::exception_ptr sink_error;
+    try {
+        // The first frame sizes the output, so it's taken before rendering starts and handed out again from here
+        const cv::Mat first = take_frame(0);
+        if (!first.empty()) {
+            result = RenderFrames(sink_path, sink_options, frame_count,
+                [&](const int i) { return i == 0 ? first : take_frame(i); }, first.size(), source.get_fps());
+        }
+    } catch (...) {
+        sink_error = std::current_exception();
+    }
+    stop(nullptr);
+    for (std::thread& thread : threads) thread.join();
+    run_seconds = std::chrono::duration<double>(Clock::now() - run_start).count();
+
+    if (stage_error) std::rethrow_exception(stage_error);
+    if (source_failed) return SeqErrorCodes::BadPath;
+    if (sink_error) std::rethrow_exception(sink_error);
+    return result;
+}
+
+Quest::FrameGenerator Quest::stream(const std::filesystem::path path, const int prefetch) {
+    FrameSource source;
+    if (source.open(path) != SeqErrorCodes::Success) {
+        throw SeqException(("Failed to open stream " + path.string()).c_str());
+    }
+
+    BoundedQueue<cv::Mat> prefetched(std::max(1, prefetch));
+    std::atomic<int> failed_frame = -1;
+    const ThreadPool::Reservation reservation;
+    std::thread reader([&] {
+        for (int i = 0; i < source.get_frame_count(); i++) {
+            cv::Mat frame;
+            try {
+                frame = source.read();
+            } catch (const std::exception&) {
+                frame.release();
+            }
+            if (frame.empty()) {
+                if (i < source.get_frame_count()) failed_frame = i;
+                break;
+            }
+            if (!prefetched.push(std::move(frame))) break;
+        }
+        prefetched.close();
+    });
+    // Destroyed with the coroutine, including when the loop leaves early, and stops the reader before it goes
+    struct ReaderStop {
+        BoundedQueue<cv::Mat>& queue;
+        std::thread& thread;
+
+        ~ReaderStop() {
+            queue.close();
+            thread.join();
+        }
+    } reader_stop {prefetched, reader};
+
+    while (std::optional<cv::Mat> frame = prefetched.pop()) {
+        co_yield std::move(*frame);
+    }
+    if (failed_frame >= 0) {
+        const std::string message = "Failed to read frame " + std::to_string(failed_frame) + " of stream " + path.string();
+        throw SeqException(message.c_str());
     }
 }
 
-Quest::Proxy::Proxy(const ImageSeq& original, const double resize_scale) {
+Quest::Proxy::Proxy(const ImageSeq& original, const double resize_scale) : Proxy(SeqView(original), resize_scale) {}
+
+Quest::Proxy::Proxy(const SeqView& original, const double resize_scale) {
     if (resize_scale <= 0 || resize_scale > 1) {
         throw SeqException("Proxy Sequences must have a resize scale of between 0 and 1");
     }
@@ -229,66 +3161,64 @@ Quest::Proxy::Proxy(const ImageSeq& original, const double resize_scale) {
     scale = resize_scale;
     frame_count = original.get_frame_count();
     for (const auto& frame : original) {
-        cv::Mat resized_frame;
-        cv::resize(frame, resized_frame, cv::Size(), resize_scale, resize_scale, cv::INTER_AREA);
+        // INTER_AREA has no half float kernel, so half frames are resized as full floats
+        FramePool& pool = FramePool::global();
+        const cv::Size proxy_size(cvRound(frame.cols * resize_scale), cvRound(frame.rows * resize_scale));
+        cv::Mat resized_frame = pool.acquire(proxy_size, frame.type());
+        if (frame.depth() == CV_16F) {
+            cv::Mat float_frame = pool.acquire(frame.size(), CV_MAKETYPE(CV_32F, frame.channels()));
+            cv::Mat resized_float = pool.acquire(proxy_size, float_frame.type());
+            frame.convertTo(float_frame, CV_32F);
+            cv::resize(float_frame, resized_float, proxy_size, 0, 0, cv::INTER_AREA);
+            resized_float.convertTo(resized_frame, CV_16F);
+        } else {
+            cv::resize(frame, resized_frame, proxy_size, 0, 0, cv::INTER_AREA);
+        }
         frames.push_back(resized_frame);
     }
     width = frames[0].cols;
     height = frames[0].rows;
+    mark_clean(std::filesystem::path(), std::nullopt);
 }
 
 bool Quest::MatEquals(const cv::Mat& mat_1, const cv::Mat& mat_2) {
-    if ((mat_1.type() != 16 && mat_1.type() != 24) || (mat_2.type() != 16 && mat_2.type() != 24)) {
-        throw SeqException("This function only supports CV Mat types of CV_8UC3 (default Mat type) or CV_8UC4");
-    }
-
-    // Return false if one mat has an alpha and the other does not
+    // Return false if the depths or channel counts differ, e.g. one mat has an alpha and the other does not
     if (mat_1.type() != mat_2.type()) return false;
 
     if (mat_1.rows != mat_2.rows || mat_1.cols != mat_2.cols) return false;
 
-    switch (mat_1.type()) {
-    case 16: {
-        cv::MatConstIterator_<cv::Vec3b> mat_1_it, mat_2_it, mat_1_end;
-        for (mat_1_it = mat_1.begin<cv::Vec3b>(), mat_2_it = mat_2.begin<cv::Vec3b>(),
-            mat_1_end = mat_1.end<cv::Vec3b>(); mat_1_it < mat_1_end;
-            ++mat_1_it, ++mat_2_it) {
-            for (int ch = 0; ch < 3; ch++) {
-                if ((*mat_1_it)[ch] != (*mat_2_it)[ch]) return false;
-            }
-            }
-        break;
-    }
-    case 24: {
-        cv::MatConstIterator_<cv::Vec4b> mat_1_it, mat_2_it, mat_1_end;
-        for (mat_1_it = mat_1.begin<cv::Vec4b>(), mat_2_it = mat_2.begin<cv::Vec4b>(),
-            mat_1_end = mat_1.end<cv::Vec4b>(); mat_1_it < mat_1_end;
-            ++mat_1_it, ++mat_2_it) {
-            for (int ch = 0; ch < 4; ch++) {
-                if ((*mat_1_it)[ch] != (*mat_2_it)[ch]) return false;
-            }
-            }
-        break;
+    // Exact equality is a bytewise comparison whatever the depth and channel count, so a single memcmp per row
+    // (or one for the whole Mat when both are continuous) covers every type with libc's vectorized compare
+    const size_t row_bytes = mat_1.cols * mat_1.elemSize();
+    if (mat_1.isContinuous() && mat_2.isContinuous()) {
+        return std::memcmp(mat_1.data, mat_2.data, row_bytes * mat_1.rows) == 0;
     }
-    default:
-        throw SeqException("Something went wrong");
+    for (int y = 0; y < mat_1.rows; y++) {
+        if (std::memcmp(mat_1.ptr(y), mat_2.ptr(y), row_bytes) != 0) return false;
     }
     return true;
 }
 
 // Image Seq Equality Operators Compares the Frames Only
 bool Quest::operator==(const ImageSeq& seq_1, const ImageSeq& seq_2) {
-    if (seq_1.get_frame_count() != seq_2.get_frame_count()) return false;
-    if (seq_1.get_height() != seq_2.get_height() || seq_1.get_width() != seq_2.get_width()) return false;
-    for (int i = 0; i < seq_1.get_frame_count(); i++) {
-        if (Quest::MatNotEquals(seq_1[i], seq_2[i])) return false;
+    return SeqView(seq_1) == SeqView(seq_2);
+}
+
+bool Quest::operator==(const SeqView& view_1, const SeqView& view_2) {
+    if (view_1.get_frame_count() != view_2.get_frame_count()) return false;
+    if (view_1.get_height() != view_2.get_height() || view_1.get_width() != view_2.get_width()) return false;
+    for (int i = 0; i < view_1.get_frame_count(); i++) {
+        // Frames are taken by value, since two views of one compressed sequence could push each other's frame
+        // out of the hot cache
+        if (Quest::MatNotEquals(view_1.get_frame(i), view_2.get_frame(i))) return false;
     }
     return true;
 }
 
 void Quest::GiveMatAlpha(cv::Mat& image, const int& alpha_val) {
-    if (image.type() != 16 && image.type() != 24) {
-        throw SeqException("This function only supports CV Mat types of CV_8UC3 (default Mat type) or CV_8UC4");
+    const int channels = image.channels();
+    if (channels != 1 && channels != 3 && channels != 4) {
+        throw SeqException("This function only supports CV Mats with 1 (grayscale), 3 (BGR) or 4 (BGRA) channels");
     }
     if (image.rows <= 0 || image.cols <= 0) {
         throw SeqException("The Mat must have dimensions greater than 0 x 0");
@@ -298,13 +3228,26 @@ void Quest::GiveMatAlpha(cv::Mat& image, const int& alpha_val) {
         throw SeqException("Alpha value must be between 0 and 255");
     }
 
-    const cv::Size frame_size = cv::Size(image.cols, image.rows);
-    const cv::Mat pure_white(frame_size, CV_8UC1, cv::Scalar(alpha_val));
-    image.convertTo(image, CV_8UC4);
-    cv::Mat channels[4];
-    cv::split(image, channels);
-    pure_white.copyTo(channels[3]);
-    cv::merge(channels, 4, image);
+    // alpha_val is on the 8 bit scale, so stretch it to the same intensity at the image's depth
+    const int depth = image.depth();
+    double scaled_alpha = alpha_val * DepthMaxValue(depth) / 255;
+    if (depth != CV_32F && depth != CV_64F && depth != CV_16F) scaled_alpha = std::round(scaled_alpha);
+    FramePool& pool = FramePool::global();
+    cv::Mat alpha = pool.acquire(image.size(), CV_MAKETYPE(depth, 1));
+    alpha.setTo(cv::Scalar(scaled_alpha));
+
+    // mixChannels just moves elements around, so one call handles every depth and writes the result in a single pass
+    if (channels == 4) {
+        constexpr int alpha_to_alpha[] = {0, 3};
+        cv::mixChannels(&alpha, 1, &image, 1, alpha_to_alpha, 1);
+        return;
+    }
+    const cv::Mat sources[] = {image, alpha};
+    cv::Mat with_alpha = pool.acquire(image.size(), CV_MAKETYPE(depth, 4));
+    constexpr int bgr_to_bgra[] = {0, 0, 1, 1, 2, 2, 3, 3};
+    constexpr int gray_to_bgra[] = {0, 0, 0, 1, 0, 2, 1, 3};
+    cv::mixChannels(sources, 2, &with_alpha, 1, channels == 3 ? bgr_to_bgra : gray_to_bgra, 4);
+    image = with_alpha;
 }
 
 void Quest::GiveMatPureWhiteAlpha(cv::Mat& image) {
@@ -315,3 +3258,178 @@ void Quest::GiveMatPureBlackAlpha(cv::Mat& image) {
     GiveMatAlpha(image, 0);
 }
 
+
+cv::Mat Quest::ReadRawFrame(const std::filesystem::path& file_path) {
+    auto mapping = std::make_shared<MappedFile>(file_path);
+    if (!mapping->valid() || mapping->length < raw_frame_header_size) return {};
+
+    RawFrameHeader header {};
+    std::memcpy(&header, mapping->bytes(), sizeof(header));
+    if (std::memcmp(header.magic, raw_frame_magic, sizeof(raw_frame_magic)) != 0 || header.version != raw_frame_version
+        || header.rows <= 0 || header.cols <= 0) {
+        return {};
+    }
+    // A type with bits outside its depth and channel count, or more than 4 channels, is a corrupted header rather than
+    // a frame. Every depth up to CV_16F is one the library handles
+    const int channels = CV_MAT_CN(header.type);
+    if (header.type < 0 || header.type != CV_MAKETYPE(CV_MAT_DEPTH(header.type), channels) || channels > 4) {
+        return {};
+    }
+    const size_t pixel_bytes = static_cast<size_t>(header.step) * header.rows;
+    if (header.step < static_cast<size_t>(header.cols) * CV_ELEM_SIZE(header.type)
+        || mapping->length < raw_frame_header_size + pixel_bytes) {
+        return {};
+    }
+
+    uchar* pixels = mapping->bytes() + raw_frame_header_size;
+    return WrapSharedBuffer(header.rows, header.cols, header.type, pixels, header.step, std::move(mapping));
+}
+
+bool Quest::WriteRawFrame(const std::filesystem::path& file_path, const cv::Mat& image) {
+    if (image.empty() || image.dims != 2) return false;
+
+    // Continuous Mats go out as one large write, others get compacted first so the file never has row padding
+    const cv::Mat pixels = image.isContinuous() ? image : image.clone();
+    RawFrameHeader header {};
+    std::memcpy(header.magic, raw_frame_magic, sizeof(raw_frame_magic));
+    header.version = raw_frame_version;
+    header.rows = pixels.rows;
+    header.cols = pixels.cols;
+    header.type = pixels.type();
+    header.step = static_cast<uint32_t>(pixels.cols * pixels.elemSize());
+
+    char header_block[raw_frame_header_size] = {};
+    std::memcpy(header_block, &header, sizeof(header));
+
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(header_block, raw_frame_header_size);
+    file.write(reinterpret_cast<const char*>(pixels.data), static_cast<std::streamsize>(header.step) * header.rows);
+    return static_cast<bool>(file);
+}
+
+cv::Mat Quest::ReadDpxFrame(const std::filesystem::path& file_path) {
+    const auto mapping = std::make_shared<MappedFile>(file_path);
+    if (!mapping->valid() || mapping->length < dpx_header_size) return {};
+    const uchar* bytes = mapping->bytes();
+
+    // The magic number tells us which byte order the rest of the header and the image data are in
+    bool swap;
+    if (LoadDpxValue<uint32_t>(bytes + DpxOffsets::magic, false) == dpx_magic) swap = false;
+    else if (LoadDpxValue<uint32_t>(bytes + DpxOffsets::magic, true) == dpx_magic) swap = true;
+    else return {};
+
+    const auto cols = static_cast<int>(LoadDpxValue<uint32_t>(bytes + DpxOffsets::pixels_per_line, swap));
+    const auto rows = static_cast<int>(LoadDpxValue<uint32_t>(bytes + DpxOffsets::lines_per_element, swap));
+    const uint8_t descriptor = bytes[DpxOffsets::descriptor];
+    const uint8_t bit_size = bytes[DpxOffsets::bit_size];
+    const uint16_t packing = LoadDpxValue<uint16_t>(bytes + DpxOffsets::packing, swap);
+    const uint16_t encoding = LoadDpxValue<uint16_t>(bytes + DpxOffsets::encoding, swap);
+    uint32_t data_offset = LoadDpxValue<uint32_t>(bytes + DpxOffsets::data_offset, swap);
+    if (data_offset == dpx_undefined || data_offset == 0) data_offset = LoadDpxValue<uint32_t>(bytes + DpxOffsets::image_offset, swap);
+    uint32_t eol_padding = LoadDpxValue<uint32_t>(bytes + DpxOffsets::eol_padding, swap);
+    if (eol_padding == dpx_undefined) eol_padding = 0;
+
+    if (rows <= 0 || cols <= 0 || encoding != 0) return {};
+    int channels;
+    if (descriptor == dpx_descriptor_luma) channels = 1;
+    else if (descriptor == dpx_descriptor_rgb) channels = 3;
+    else if (descriptor == dpx_descriptor_rgba) channels = 4;
+    else return {};
+
+    // Every line is filled out to a 32 bit boundary
+    const size_t components = static_cast<size_t>(cols) * channels;
+    size_t line_bytes;
+    int depth;
+    switch (bit_size) {
+    case 8: line_bytes = (components + 3) / 4 * 4; depth = CV_8U; break;
+    case 10: line_bytes = (components + 2) / 3 * 4; depth = CV_16U; break;
+    case 16: line_bytes = (components * 2 + 3) / 4 * 4; depth = CV_16U; break;
+    default: return {};
+    }
+    if (bit_size == 10 && packing != 1 && packing != 2) return {};
+    line_bytes += eol_padding;
+    if (data_offset + line_bytes * rows > mapping->length) return {};
+
+    cv::Mat image(rows, cols, CV_MAKETYPE(depth, channels));
+    if (bit_size == 10) {
+        // One unpacker per byte order and packing method. Method B pads the top two bits of each word instead of
+        // the bottom
+        const uchar* data = bytes + data_offset;
+        const bool big_endian = swap == (std::endian::native == std::endian::little);
+        if (big_endian) {
+            if (packing == 2) UnpackDpx10BitFrame<true, 20>(data, line_bytes, image);
+            else UnpackDpx10BitFrame<true, 22>(data, line_bytes, image);
+        } else {
+            if (packing == 2) UnpackDpx10BitFrame<false, 20>(data, line_bytes, image);
+            else UnpackDpx10BitFrame<false, 22>(data, line_bytes, image);
+        }
+        return image;
+    }
+    for (int y = 0; y < rows; y++) {
+        const uchar* src = bytes + data_offset + line_bytes * y;
+        switch (bit_size) {
+        case 8: {
+            auto* dst = image.ptr<uchar>(y);
+            for (size_t k = 0; k < components; k++) {
+                dst[k / channels * channels + DpxChannel(static_cast<int>(k % channels), channels)] = src[k];
+            }
+        } break;
+        case 16: {
+            auto* dst = image.ptr<ushort>(y);
+            for (size_t k = 0; k < components; k++) {
+                dst[k / channels * channels + DpxChannel(static_cast<int>(k % channels), channels)] =
+                    LoadDpxValue<uint16_t>(src + 2 * k, swap);
+            }
+        } break;
+        default: return {};
+        }
+    }
+    return image;
+}
+
+bool Quest::WriteDpxFrame(const std::filesystem::path& file_path, const cv::Mat& image) {
+    const int channels = image.channels();
+    if (image.empty() || image.dims != 2 || channels == 2) {
+        return false;
+    }
+    const cv::Mat pixels = image.depth() == CV_8U ? image : ConvertDepth(image, CV_16U);
+    uint8_t descriptor = dpx_descriptor_rgb;
+    if (channels == 1) descriptor = dpx_descriptor_luma;
+    if (channels == 4) descriptor = dpx_descriptor_rgba;
+
+    // Header and pixels are assembled in one buffer so the file goes out in a single sequential write
+    const size_t line_bytes = (static_cast<size_t>(image.cols) * channels + 2) / 3 * 4;
+    const size_t file_size = dpx_header_size + line_bytes * image.rows;
+    std::vector<uchar> file_bytes(file_size, 0);
+    uchar* header = file_bytes.data();
+
+    StoreBigEndian<uint32_t>(header + DpxOffsets::magic, dpx_magic);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::image_offset, dpx_header_size);
+    std::memcpy(header + DpxOffsets::version, "V2.0", 4);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::file_size, static_cast<uint32_t>(file_size));
+    StoreBigEndian<uint32_t>(header + DpxOffsets::ditto_key, 1);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::generic_size, 1664);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::industry_size, 384);
+    StoreBigEndian<uint16_t>(header + DpxOffsets::element_count, 1);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::pixels_per_line, image.cols);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::lines_per_element, image.rows);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::ref_high_data, 1023);
+    StoreBigEndian<float>(header + DpxOffsets::ref_high_quantity, 2.047f);
+    header[DpxOffsets::descriptor] = descriptor;
+    header[DpxOffsets::transfer] = 2; // Linear
+    header[DpxOffsets::colorimetric] = 2; // Linear
+    header[DpxOffsets::bit_size] = 10;
+    StoreBigEndian<uint16_t>(header + DpxOffsets::packing, 1);
+    StoreBigEndian<uint16_t>(header + DpxOffsets::encoding, 0);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::data_offset, dpx_header_size);
+    StoreBigEndian<uint32_t>(header + DpxOffsets::eol_padding, 0);
+
+    if (pixels.depth() == CV_16U) PackDpx10BitFrame<ushort>(pixels, header + dpx_header_size, line_bytes);
+    else PackDpx10BitFrame<uchar>(pixels, header + dpx_header_size, line_bytes);
+
+    std::ofstream file(file_path, std::ios::binary | std::ios::trunc);
+    if (!file) return false;
+    file.write(reinterpret_cast<const char*>(file_bytes.data()), static_cast<std::streamsize>(file_size));
+    return static_cast<bool>(file);
+}
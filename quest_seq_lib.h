@@ -1,13 +1,34 @@
 #ifndef QUEST_IMAGE_SEQ_LIB_LIBRARY_H
 #define QUEST_IMAGE_SEQ_LIB_LIBRARY_H
 
+#include <atomic>
+#include <compare>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
 #include <opencv2/opencv.hpp>
 
 namespace Quest {
     // Default fps to use if writing a video but no fps was given in metadata
     constexpr double default_fps = 24;
 
+    // Minimum number of frames each worker decodes when a video is split into segments for parallel decoding.
+    // Shorter videos are decoded on a single VideoCapture since opening and seeking a capture isn't free
+    constexpr int min_video_segment_frames = 48;
+
+    // Most memory FramePool::global() keeps cached for reuse
+    constexpr size_t default_frame_pool_bytes = size_t(512) << 20;
+
     inline const std::vector<std::string> supported_image_extensions = {
         ".png", ".jpg", ".jpeg", ".jpe", ".bmp", ".dib", ".jp2",
         ".webp", ".sr", ".ras",
@@ -18,7 +39,117 @@ namespace Quest {
         ".mp4", ".mov"
     };
 
-    enum class SeqErrorCodes {Success = 0, BadPath, UnsupportedExtension};
+    // Native uncompressed frame format: a fixed size header followed by the Mat's pixel data. Meant for scratch
+    // caches between pipeline stages, reads are memory mapped straight into cv::Mat headers without copying
+    constexpr const char* raw_frame_extension = ".qraw";
+    constexpr char raw_frame_magic[4] = {'Q', 'R', 'A', 'W'};
+    constexpr uint32_t raw_frame_version = 1;
+    constexpr size_t raw_frame_header_size = 64; // Keeps pixel data cache line aligned within the mapping
+
+    struct RawFrameHeader {
+        char magic[4];
+        uint32_t version;
+        int32_t rows;
+        int32_t cols;
+        int32_t type;
+        uint32_t step; // Bytes per row of pixel data
+    };
+
+    // Single file container for a whole sequence: a file header, every frame's data back to back, then an index of
+    // frame offsets and a fixed size footer pointing at it. Frames are stored raw or encoded individually
+    constexpr const char* container_extension = ".qseq";
+    constexpr char container_magic[4] = {'Q', 'S', 'E', 'Q'};
+    constexpr uint32_t container_version = 1;
+    constexpr size_t container_alignment = 64; // Frame data starts on a cache line so raw frames map straight into Mats
+
+    struct ContainerIndexEntry {
+        uint64_t offset;
+        uint64_t size;
+        int32_t rows;
+        int32_t cols;
+        int32_t type;
+        uint32_t step; // Bytes per row for raw frames
+        char codec[8]; // Image extension the frame was encoded with, empty for raw frames
+    };
+
+    struct ContainerFooter {
+        char magic[4];
+        uint32_t version;
+        uint64_t index_offset;
+        uint64_t frame_count;
+        double fps;
+    };
+
+    // DPX frames are read and written by the library itself. Reads handle 8, 10 (filled method A or B) and 16 bit
+    // luma/RGB/RGBA in either byte order, 10 bit data is widened to CV_16U. Writes are always 10 bit method A, as
+    // luma, RGB or RGBA to match the frame's 1, 3 or 4 channels. Two channel frames can't be written
+    constexpr const char* dpx_extension = ".dpx";
+    constexpr size_t dpx_header_size = 2048; // Generic plus industry header, where image data starts in written files
+
+    // OpenEXR frames are decoded by OpenCV but kept at their original float depth and channels, with no alpha forced on
+    constexpr const char* exr_extension = ".exr";
+
+    // Encoder settings ImageSeq::render passes through to OpenCV. Any value left at -1 keeps OpenCV's default
+    struct RenderOptions {
+        int png_compression = -1; // 0-9, 0-1 trade file size for much faster writes
+        int png_strategy = -1; // One of cv::IMWRITE_PNG_STRATEGY_*
+        int jpeg_quality = -1; // 0-100
+        bool jpeg_progressive = false;
+        int webp_quality = -1; // 1-100, anything above 100 is lossless
+        int tiff_compression = -1; // libtiff compression scheme, 1 writes uncompressed tiffs
+        std::string video_codec = "H264"; // FourCC of the video codec
+        int video_quality = -1; // 0-100, only honoured by backends that support cv::VIDEOWRITER_PROP_QUALITY
+        int exr_type = -1; // cv::IMWRITE_EXR_TYPE_HALF or cv::IMWRITE_EXR_TYPE_FLOAT
+        int exr_compression = -1; // One of cv::IMWRITE_EXR_COMPRESSION_*
+        std::string container_codec; // Image extension each .qseq frame is encoded with, empty stores raw frames
+        // Keep a record of the frames a sequence render writes, and keep frames an interrupted render with resume set
+        // already wrote. Set it on the first attempt too, since a render without it leaves no record behind
+        bool resume = false;
+
+        bool operator==(const RenderOptions&) const = default;
+    };
+
+    enum class SeqErrorCodes {Success = 0, BadPath, UnsupportedExtension, Cancelled};
+
+    // Frames finished so far out of the total. Called from whichever thread finished the frame, one call at a time
+    using ProgressCallback = std::function<void(int done, int total)>;
+
+    // Flag for stopping a long open or render part way through. Copies share the flag, so the caller keeps one and
+    // passes copies to the work it may want to cancel
+    class CancelToken {
+        std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+
+    public:
+        void cancel() const { *cancelled = true; }
+        [[nodiscard]] bool is_cancelled() const { return *cancelled; }
+    };
+
+    // How ImageSeq::open allocates decoded frames. The arena modes reserve one page aligned block for the whole
+    // sequence once the frame size is known and make every frame a view into it, HugePageArena also asks for huge
+    // pages (MAP_HUGETLB, falling back to transparent huge pages) where the platform has them
+    enum class FrameAllocation {PerFrame = 0, Arena, HugePageArena};
+
+    // How an ImageSeq holds its frames once they're opened. Compressed keeps 8 and 16 bit frames losslessly
+    // compressed (fast level PNG) and decodes them into a small hot cache as they're accessed. Frames at other
+    // depths can't be compressed that way and stay decoded
+    // Lazy only notes where each frame is on open and reads frames from the input as they're accessed, keeping them in
+    // the same hot cache. Videos have no cheap random access, so they're still decoded in full
+    enum class FrameStorage {Decoded = 0, Compressed, Lazy};
+
+    // Decoded frames a compressed or lazy ImageSeq keeps hot by default
+    constexpr int default_hot_cache_frames = 8;
+
+    // Frames a lazy ImageSeq reads ahead of frames being stepped through in order
+    constexpr int default_prefetch_frames = 8;
+
+    // Shots a Timeline keeps open at once when they were appended as paths
+    constexpr int default_timeline_open_shots = 2;
+
+    // Frames each queue between Pipeline stages holds before the stage feeding it has to wait
+    constexpr int default_pipeline_queue_frames = 4;
+
+    // Frames stream() reads ahead of the loop consuming them
+    constexpr int default_stream_prefetch_frames = 4;
 
     class SeqException: public std::exception {
         std::string message;
@@ -31,6 +162,213 @@ namespace Quest {
         }
     };
 
+    // Fixed capacity FIFO shared between threads. push blocks while the queue is full and pop blocks while it's
+    // empty, which gives producers backpressure. Once closed, push fails and pop drains what's left then returns nullopt
+    template<typename T>
+    class BoundedQueue {
+        std::deque<T> items;
+        size_t capacity;
+        bool closed = false;
+        std::mutex mutex;
+        std::condition_variable not_full;
+        std::condition_variable not_empty;
+
+    public:
+        // Constructors
+        explicit BoundedQueue(const size_t new_capacity) : capacity(new_capacity > 0 ? new_capacity : 1) {}
+
+        // Methods
+        bool push(T item) {
+            std::unique_lock lock(mutex);
+            not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+            if (closed) return false;
+            items.push_back(std::move(item));
+            not_empty.notify_one();
+            return true;
+        }
+
+        std::optional<T> pop() {
+            std::unique_lock lock(mutex);
+            not_empty.wait(lock, [this] { return closed || !items.empty(); });
+            if (items.empty()) return std::nullopt;
+            T item = std::move(items.front());
+            items.pop_front();
+            not_full.notify_one();
+            return item;
+        }
+
+        void close() {
+            std::lock_guard lock(mutex);
+            closed = true;
+            not_full.notify_all();
+            not_empty.notify_all();
+        }
+    };
+
+    // Recycles frame sized buffers by size and type so decoders, conversions and proxies don't allocate and free a
+    // whole frame for every frame they touch. acquire() hands out a continuous Mat backed by a pooled buffer, which
+    // returns to the pool once the last Mat sharing it is released. Buffers that would take the pool past
+    // max_cached_bytes are freed instead of kept
+    class FramePool {
+    public:
+        struct Stats {
+            size_t hits = 0; // Acquires served from a returned buffer
+            size_t misses = 0; // Acquires that had to allocate
+            size_t cached_bytes = 0; // Bytes currently waiting in the pool
+        };
+
+    private:
+        struct State;
+        std::shared_ptr<State> state;
+
+    public:
+        // Constructors
+        explicit FramePool(size_t max_cached_bytes = default_frame_pool_bytes);
+
+        // Getters and setters
+        [[nodiscard]] Stats get_stats() const;
+        void reset_stats();
+
+        // Methods
+        [[nodiscard]] cv::Mat acquire(int rows, int cols, int type);
+        [[nodiscard]] cv::Mat acquire(const cv::Size& size, const int type) {
+            return acquire(size.height, size.width, type);
+        }
+        void clear(); // Free every cached buffer
+
+        // Pool the library's own decoders and conversions draw from
+        static FramePool& global();
+    };
+
+    // Work-stealing thread pool that every parallel path in the library runs on, so decoding, rendering, proxies and
+    // per-frame processing share one set of threads instead of each starting their own. Every worker has its own
+    // task queue, taking from the front of it and stealing from the back of the others' once it runs dry.
+    // thread_count includes the thread that calls into the pool, which always works alongside its thread_count - 1
+    // workers, so waiting on the pool from inside one of its own tasks runs other tasks instead of deadlocking.
+    // While the library's work is spread over several threads OpenCV is held to one thread of its own, so the two
+    // don't multiply each other's threads (see set_limit_opencv_threads)
+    class ThreadPool {
+    public:
+        struct Stats {
+            size_t tasks_run = 0;
+            size_t tasks_stolen = 0; // Tasks a worker took from another worker's queue
+        };
+
+    private:
+        struct State;
+        std::unique_ptr<State> state;
+
+        void enqueue(std::function<void()> task);
+        bool run_pending_task();
+
+    public:
+        // Constructors
+        explicit ThreadPool(int new_thread_count = 0); // 0 for one thread per core
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        // Getters and setters
+        [[nodiscard]] int get_thread_count() const;
+        // Waits for other threads to finish using the pool and for queued tasks, then restarts the workers
+        void set_thread_count(int new_thread_count);
+        [[nodiscard]] Stats get_stats() const;
+
+        // Process wide cap on the library's threads for shared farm nodes: the pools' threads plus any held by a
+        // Reservation, with OpenCV's own pool held to the same number. 0 for no cap. Starts from the
+        // QUEST_MAX_THREADS environment variable when it's set
+        static void set_max_threads(int new_max_threads);
+        [[nodiscard]] static int get_max_threads();
+
+        // Counts threads started outside the pools against the cap for as long as it's alive, restarting the global
+        // pool smaller to make room. Takes up to count threads but never fewer than one, so a lot of them at once
+        // can still go over a small cap. Without a cap nothing is counted. Taken from one of the global pool's own
+        // tasks, the pool only shrinks once it's next restarted
+        class Reservation {
+            int threads = 0;
+            bool counted = false;
+
+        public:
+            explicit Reservation(int count = 1);
+            Reservation(const Reservation&) = delete;
+            Reservation& operator=(const Reservation&) = delete;
+            ~Reservation();
+
+            [[nodiscard]] int get_threads() const { return threads; }
+        };
+        // Whether OpenCV is held to one thread while library work runs in parallel. On by default
+        static void set_limit_opencv_threads(bool limit);
+        [[nodiscard]] static bool get_limit_opencv_threads();
+
+        // Methods
+        // Run fn(i) for every i in [0, count) on up to max_workers threads (0 for all of them), the caller
+        // included. The first exception thrown is rethrown once every index has been handed out and finished
+        void parallel_for(int count, const std::function<void(int)>& fn, int max_workers = 0);
+
+        // Queue fn to run on the pool. A pool with a single thread has no workers, so fn runs straight away
+        template<typename Fn>
+        std::future<std::invoke_result_t<Fn>> submit(Fn fn) {
+            auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Fn>()>>(std::move(fn));
+            std::future<std::invoke_result_t<Fn>> result = task->get_future();
+            enqueue([task] { (*task)(); });
+            return result;
+        }
+
+        // Wait for a submitted task's result, running queued tasks in the meantime
+        template<typename T>
+        T wait(std::future<T>& future) {
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                // Nothing left queued means the task is already running on a worker
+                if (!run_pending_task()) break;
+            }
+            return future.get();
+        }
+
+        // Pool the library's own parallel work runs on
+        static ThreadPool& global();
+    };
+
+    // Random access iterator over a sequence's frames. It goes through the sequence's operator[], so frames that
+    // aren't held decoded are decoded as they're reached. Reference is cv::Mat itself for sequences that produce
+    // frames by value, which makes it a C++20 random access iterator but only a legacy input iterator
+    template<typename Seq, typename Reference>
+    class FrameIterator {
+        Seq* seq = nullptr;
+        int index = 0;
+
+    public:
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::conditional_t<std::is_reference_v<Reference>,
+            std::random_access_iterator_tag, std::input_iterator_tag>;
+        using value_type = cv::Mat;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<std::is_reference_v<Reference>, std::remove_reference_t<Reference>*, void>;
+        using reference = Reference;
+
+        // Constructors
+        FrameIterator() = default;
+        FrameIterator(Seq* new_seq, const int new_index) : seq(new_seq), index(new_index) {}
+
+        // Operators
+        reference operator*() const { return (*seq)[index]; }
+        pointer operator->() const requires std::is_reference_v<Reference> { return &(*seq)[index]; }
+        reference operator[](const difference_type n) const { return (*seq)[index + static_cast<int>(n)]; }
+
+        FrameIterator& operator++() { ++index; return *this; }
+        FrameIterator operator++(int) { FrameIterator previous = *this; ++index; return previous; }
+        FrameIterator& operator--() { --index; return *this; }
+        FrameIterator operator--(int) { FrameIterator previous = *this; --index; return previous; }
+        FrameIterator& operator+=(const difference_type n) { index += static_cast<int>(n); return *this; }
+        FrameIterator& operator-=(const difference_type n) { index -= static_cast<int>(n); return *this; }
+        FrameIterator operator+(const difference_type n) const { return {seq, index + static_cast<int>(n)}; }
+        FrameIterator operator-(const difference_type n) const { return {seq, index - static_cast<int>(n)}; }
+        friend FrameIterator operator+(const difference_type n, const FrameIterator& it) { return it + n; }
+        difference_type operator-(const FrameIterator& other) const { return index - other.index; }
+
+        bool operator==(const FrameIterator& other) const { return index == other.index; }
+        std::strong_ordering operator<=>(const FrameIterator& other) const { return index <=> other.index; }
+    };
+
     class SeqPath {
         std::filesystem::path input_path;
         std::string pre_frame;
@@ -40,7 +378,7 @@ namespace Quest {
 
     public:
         // Constructors
-        explicit SeqPath(const std::filesystem::path& new_input_path);
+        explicit SeqPath(const std::filesystem::path& new_input_path, int first_frame = 1);
 
         // Getters and setters
         [[nodiscard]] std::filesystem::path get_input_path() const { return input_path; }
@@ -51,54 +389,493 @@ namespace Quest {
         std::string outputIncrement();
     };
 
+    // Random access reader for .qseq containers. Only the index is read on open, frames are read on demand with pread
+    class SeqContainer {
+        int fd = -1;
+        std::vector<ContainerIndexEntry> index;
+        double fps = -1;
+
+    public:
+        // Constructors
+        SeqContainer() = default;
+        SeqContainer(const SeqContainer&) = delete;
+        SeqContainer& operator=(const SeqContainer&) = delete;
+        ~SeqContainer();
+
+        // Getters and setters
+        [[nodiscard]] int get_frame_count() const { return static_cast<int>(index.size()); }
+        [[nodiscard]] double get_fps() const { return fps; }
+        [[nodiscard]] const ContainerIndexEntry& get_index_entry(const int& i) const { return index.at(i); }
+
+        // Methods
+        Quest::SeqErrorCodes open(const std::filesystem::path& container_path);
+        [[nodiscard]] cv::Mat read_frame(const int& i) const;
+    };
+
     class ImageSeq {
     protected:
         std::filesystem::path input_path = "";
         std::filesystem::path output_path = "";
-        std::vector<cv::Mat> frames;
+        mutable std::vector<cv::Mat> frames; // Const access decodes compressed frames into here
         int frame_count = -1;
         int width = -1;
         int height = -1;
         double fps = -1;
+        FrameAllocation allocation = FrameAllocation::PerFrame;
+        cv::Mat arena;
+
+        // Compressed storage. frames then holds only the hot (recently accessed) frames decoded, plus any frame that
+        // couldn't be compressed
+        FrameStorage storage = FrameStorage::Decoded;
+        int hot_cache_frames = default_hot_cache_frames;
+        mutable std::vector<std::vector<uchar>> compressed_frames;
+        mutable std::vector<uint64_t> frame_checksums; // Content of each hot frame when it was decoded
+        mutable std::deque<int> hot_frames; // Most recently accessed first
+        mutable std::mutex cache_mutex;
+
+        // Memory budget. Once decoded frames take up more than memory_budget bytes (0 for no limit), the least
+        // recently used ones are spilled to a scratch file and mapped back in when they're accessed
+        struct SpillFile;
+        size_t memory_budget = 0;
+        std::filesystem::path scratch_directory; // The system temp directory when empty
+        std::shared_ptr<SpillFile> spill_file;
+
+        // Lazy storage. Frames that are changed can't be read back from the input, so they stay decoded outside the
+        // hot frames. Stepping through frames one at a time in either direction has the next prefetch_window frames
+        // read ahead on the thread pool
+        enum class PrefetchState : uint8_t {Idle, Queued, Reading};
+        std::function<cv::Mat(int)> read_source_frame; // Empty when the input can't be read a frame at a time
+        int prefetch_window = default_prefetch_frames;
+        mutable std::vector<PrefetchState> prefetch_state;
+        mutable std::vector<std::future<void>> prefetch_tasks;
+        mutable std::condition_variable frame_read;
+        mutable int last_accessed = -1;
+
+        // Frames changed since the sequence was opened from or last rendered to clean_path. Rendering a frame padded
+        // sequence back to clean_path only writes these. A frame handed out through a non-const operator[] is only
+        // Touched, and counts as changed if its checksum no longer matches clean_checksums. Those are taken while
+        // frames are decoded or rendered anyway, so handing a frame out costs nothing, and are 0 for lazy frames that
+        // haven't been read yet. clean_options is empty when the files there are the ones that were opened, which
+        // only default options match
+        enum class FrameChange : uint8_t {Clean, Touched, Changed};
+        std::filesystem::path clean_path;
+        std::optional<RenderOptions> clean_options;
+        std::vector<FrameChange> dirty_frames;
+        mutable std::vector<uint64_t> clean_checksums; // Filled in by const reads of lazy frames
+
+        void mark_clean(const std::filesystem::path& new_clean_path, const std::optional<RenderOptions>& options);
+        [[nodiscard]] bool is_dirty(int i) const;
+        Quest::SeqErrorCodes open_frames(const std::filesystem::path& new_input_path, const ProgressCallback& progress,
+            const CancelToken& cancel, const std::vector<std::vector<uchar>>* encoded_frames = nullptr);
+        void compress_frames();
+        void load_frame(int index) const;
+        void trim_hot_frames() const;
+        void prefetch_after(int index) const;
+        void prefetch_frame(int index) const;
+        void finish_prefetches() const;
 
     public:
         // Constructors
         ImageSeq() = default;
         ImageSeq(const ImageSeq& original); // Copy constructor
+        ~ImageSeq(); // Waits for any prefetches still reading frames into it
 
         // Getters and setters
         [[nodiscard]] std::filesystem::path get_input_path() const { return input_path; }
         [[nodiscard]] std::filesystem::path get_output_path() const { return output_path; }
         [[nodiscard]] int get_frame_count() const { return frame_count; }
-        [[nodiscard]] cv::Mat get_frame(const int& i) const { return frames[i]; }
-        void set_frame(const int& i, const cv::Mat& new_frame) { frames[i] = new_frame; }
+        // get_frame and set_frame are safe to call from several threads at once in either storage mode
+        [[nodiscard]] cv::Mat get_frame(const int& i) const;
+        void set_frame(const int& i, const cv::Mat& new_frame);
         [[nodiscard]] int get_width() const { return width; }
         [[nodiscard]] int get_height() const { return height; }
         [[nodiscard]] double get_fps() const { return fps; }
+        [[nodiscard]] FrameAllocation get_allocation() const { return allocation; }
+        void set_allocation(const FrameAllocation& new_allocation) { allocation = new_allocation; }
+        // The arena backing the frames as one continuous CV_8UC1 Mat (data to data + total()), empty if frames
+        // were allocated individually
+        [[nodiscard]] cv::Mat get_arena() const { return arena; }
+        [[nodiscard]] FrameStorage get_storage() const { return storage; }
+        // Converts any frames already opened. Frames opened before switching to Lazy stay decoded until the next open
+        void set_storage(const FrameStorage& new_storage);
+        [[nodiscard]] int get_hot_cache_frames() const { return hot_cache_frames; }
+        void set_hot_cache_frames(const int& new_hot_cache_frames) { hot_cache_frames = std::max(1, new_hot_cache_frames); }
+        [[nodiscard]] size_t get_memory_budget() const { return memory_budget; }
+        void set_memory_budget(const size_t& new_memory_budget); // Spills frames straight away if already over it
+        [[nodiscard]] std::filesystem::path get_scratch_directory() const { return scratch_directory; }
+        void set_scratch_directory(const std::filesystem::path& new_scratch_directory) {
+            scratch_directory = new_scratch_directory;
+        }
+        [[nodiscard]] size_t get_resident_bytes() const; // Bytes of decoded frames currently held in memory
+        // Frames changed through set_frame, a non-const operator[] or an iterator since the last open or render
+        [[nodiscard]] int get_dirty_frame_count() const;
+        [[nodiscard]] int get_prefetch_window() const { return prefetch_window; }
+        void set_prefetch_window(const int& new_prefetch_window) { prefetch_window = std::max(0, new_prefetch_window); }
+
+        // Methods. fn runs on up to concurrency frames at once (0 for one per hardware thread), so it must be safe to
+        // call on different frames at the same time. Each result is stored at its frame's index, so the output is
+        // the same as a serial loop whatever order the frames finish in
+        void for_each_parallel(const std::function<void(cv::Mat&)>& fn, int concurrency = 0);
+        [[nodiscard]] ImageSeq transform_parallel(const std::function<cv::Mat(const cv::Mat&)>& fn,
+            int concurrency = 0) const; // A new, fully decoded sequence of fn's results
 
         // Iterators
-        std::vector<cv::Mat>::iterator begin() { return frames.begin(); }
-        std::vector<cv::Mat>::iterator end() { return frames.end(); }
-        [[nodiscard]] std::vector<cv::Mat>::const_iterator begin() const { return frames.begin(); }
-        [[nodiscard]] std::vector<cv::Mat>::const_iterator end() const { return frames.end(); }
+        using iterator = FrameIterator<ImageSeq, cv::Mat&>;
+        using const_iterator = FrameIterator<const ImageSeq, const cv::Mat&>;
+        iterator begin() { return {this, 0}; }
+        iterator end() { return {this, static_cast<int>(frames.size())}; }
+        [[nodiscard]] const_iterator begin() const { return {this, 0}; }
+        [[nodiscard]] const_iterator end() const { return {this, static_cast<int>(frames.size())}; }
 
-        // Operators
+        // Operators. With compressed or lazy storage, references stay valid but the frame is released once it drops
+        // out of the hot cache, and writes through them are compressed back (or kept, when lazy) at that point. Keep
+        // a cv::Mat copy to hold on to a frame, and use get_frame/set_frame rather than operator[] from multiple
+        // threads
         cv::Mat& operator[](const int& index);
         const cv::Mat& operator[] (const int& index) const;
         ImageSeq& operator=(const ImageSeq& original);
 
-        // Image IO
-        Quest::SeqErrorCodes open(const std::filesystem::path& new_input_path);
-        Quest::SeqErrorCodes render(const std::filesystem::path& new_output_path);
+        // Image IO. progress is called as frames finish, and cancelling stops an open or render between frames with
+        // SeqErrorCodes::Cancelled. A cancelled open leaves the sequence as it was. Rendered files only appear once
+        // they're complete, and a sequence render with RenderOptions::resume set that's cancelled or dies part way
+        // can be finished by rendering it again the same way, which skips the frames it already wrote. Rendering a
+        // sequence back to the frame padded path it was opened from or last rendered to, with the same options, only
+        // writes the frames changed since then
+        Quest::SeqErrorCodes open(const std::filesystem::path& new_input_path,
+            const ProgressCallback& progress = nullptr, const CancelToken& cancel = CancelToken());
+        Quest::SeqErrorCodes render(const std::filesystem::path& new_output_path,
+            const RenderOptions& options = RenderOptions(), const ProgressCallback& progress = nullptr,
+            const CancelToken& cancel = CancelToken());
+        // open and render for frame files held in memory, one encoded buffer per frame, decoded and encoded in
+        // parallel. Any format OpenCV can decode opens, and frames render to any supported image extension or EXR
+        // (e.g. ".png"). A failed render leaves encoded_frames untouched, and an open leaves the input path empty
+        Quest::SeqErrorCodes open(const std::vector<std::vector<uchar>>& encoded_frames,
+            const ProgressCallback& progress = nullptr, const CancelToken& cancel = CancelToken());
+        Quest::SeqErrorCodes render(std::vector<std::vector<uchar>>& encoded_frames, const std::string& extension,
+            const RenderOptions& options = RenderOptions(), const ProgressCallback& progress = nullptr,
+            const CancelToken& cancel = CancelToken()) const;
+        // open and render on a thread of their own. The sequence must stay alive and otherwise unused until the
+        // future is ready
+        [[nodiscard]] std::future<Quest::SeqErrorCodes> open_async(const std::filesystem::path& new_input_path,
+            const ProgressCallback& progress = nullptr, const CancelToken& cancel = CancelToken());
+        [[nodiscard]] std::future<Quest::SeqErrorCodes> render_async(const std::filesystem::path& new_output_path,
+            const RenderOptions& options = RenderOptions(), const ProgressCallback& progress = nullptr,
+            const CancelToken& cancel = CancelToken());
 
         // Friend Functions
         friend void Copy(const ImageSeq& original, ImageSeq& copy);
     };
 
+    // Non-owning view of some of an ImageSeq's frames: a range, every nth frame, reversed, or any mix of them. Views
+    // share the sequence's frames instead of copying them, so taking one is O(1), and they must not outlive it
+    class SeqView {
+        const ImageSeq* seq = nullptr;
+        int start = 0; // Index in seq of the view's first frame
+        int step = 1; // Distance in seq between consecutive frames, negative when reversed
+        int count = 0;
+
+        SeqView(const ImageSeq* new_seq, const int new_start, const int new_step, const int new_count)
+            : seq(new_seq), start(new_start), step(new_step), count(new_count) {}
+
+    public:
+        // Constructors
+        SeqView() = default;
+        SeqView(const ImageSeq& new_seq); // Whole sequence, implicit so a sequence can go wherever a view can
+
+        // Getters and setters
+        [[nodiscard]] std::filesystem::path get_input_path() const { return seq ? seq->get_input_path() : ""; }
+        [[nodiscard]] int get_frame_count() const { return count; }
+        [[nodiscard]] int get_width() const { return seq ? seq->get_width() : -1; }
+        [[nodiscard]] int get_height() const { return seq ? seq->get_height() : -1; }
+        [[nodiscard]] double get_fps() const { return seq ? seq->get_fps() : -1; }
+        [[nodiscard]] int get_source_index(const int& i) const { return start + i * step; } // Frame i's index in seq
+        [[nodiscard]] cv::Mat get_frame(const int& i) const { return seq->get_frame(get_source_index(i)); }
+
+        // Iterators
+        using const_iterator = FrameIterator<const SeqView, const cv::Mat&>;
+        [[nodiscard]] const_iterator begin() const { return {this, 0}; }
+        [[nodiscard]] const_iterator end() const { return {this, count}; }
+
+        // Operators
+        const cv::Mat& operator[](const int& index) const;
+
+        // Methods - each returns a new view of this one
+        [[nodiscard]] SeqView slice(int first, int last) const; // Frames [first, last)
+        [[nodiscard]] SeqView stride(int n) const; // Every nth frame, starting with the first
+        [[nodiscard]] SeqView reversed() const;
+
+        // Image IO
+        [[nodiscard]] Quest::SeqErrorCodes render(const std::filesystem::path& output_path,
+            const RenderOptions& options = RenderOptions()) const;
+    };
+
+    // Virtual sequence that plays several shots back to back without copying their frames, for conforming reels.
+    // Shots are either views of sequences owned elsewhere, which must outlive the timeline, or paths that are only
+    // opened when one of their frames is first needed. At most max_open_shots path shots are kept open at once, so
+    // references from operator[] into a path shot only last until that many other shots have been opened
+    class Timeline {
+        struct Shot {
+            mutable SeqView view; // The shot's frames, empty for a path shot that isn't open
+            std::filesystem::path path; // Empty for shots appended as views
+            int frame_count = 0;
+            mutable std::shared_ptr<ImageSeq> opened;
+        };
+
+        std::vector<Shot> shots;
+        std::vector<int> shot_starts; // Timeline frame each shot starts on
+        int frame_count = 0;
+        int max_open_shots = default_timeline_open_shots;
+        mutable std::deque<int> open_shots; // Path shots that are open, most recently opened first
+        mutable std::mutex mutex;
+
+        const Shot& shot_at(int i, int& shot_frame) const;
+
+    public:
+        // Constructors
+        Timeline() = default;
+        Timeline(const Timeline&) = delete;
+        Timeline& operator=(const Timeline&) = delete;
+
+        // Getters and setters
+        [[nodiscard]] int get_frame_count() const { return frame_count; }
+        [[nodiscard]] int get_shot_count() const { return static_cast<int>(shots.size()); }
+        [[nodiscard]] int get_width() const; // Size and fps come from the first shot
+        [[nodiscard]] int get_height() const;
+        [[nodiscard]] double get_fps() const;
+        [[nodiscard]] cv::Mat get_frame(const int& i) const; // Safe to call from several threads at once
+        [[nodiscard]] int get_max_open_shots() const { return max_open_shots; }
+        void set_max_open_shots(const int& new_max_open_shots) { max_open_shots = std::max(1, new_max_open_shots); }
+
+        // Iterators
+        using const_iterator = FrameIterator<const Timeline, const cv::Mat&>;
+        [[nodiscard]] const_iterator begin() const { return {this, 0}; }
+        [[nodiscard]] const_iterator end() const { return {this, frame_count}; }
+
+        // Operators
+        const cv::Mat& operator[](const int& index) const;
+
+        // Methods
+        void append(const SeqView& view);
+        // Only counts the frames until they're needed. Frame access throws a SeqException if the shot has fewer frames
+        // by the time it's opened
+        Quest::SeqErrorCodes append(const std::filesystem::path& path);
+
+        // Image IO
+        [[nodiscard]] Quest::SeqErrorCodes render(const std::filesystem::path& output_path,
+            const RenderOptions& options = RenderOptions()) const;
+    };
+
+    // Lazy, read only sequence of frames, each one produced from its index only when it's asked for. Made by piping
+    // a sequence, view or timeline through the Quest::views adaptors, and rendered straight through without ever
+    // holding more than the frames in flight. Like SeqView it doesn't own the frames it reads from. Rendering can
+    // ask for several frames at once, so transforms must be safe to run on different frames concurrently
+    class FrameRange {
+        std::function<cv::Mat(int)> frame_at;
+        int count = 0;
+        double fps = -1;
+
+    public:
+        // Constructors
+        FrameRange() = default;
+        FrameRange(std::function<cv::Mat(int)> new_frame_at, int new_count, double new_fps = -1);
+        FrameRange(const ImageSeq& seq);
+        FrameRange(const SeqView& view);
+        FrameRange(const Timeline& timeline);
+
+        // Getters and setters
+        [[nodiscard]] int get_frame_count() const { return count; }
+        [[nodiscard]] double get_fps() const { return fps; }
+        [[nodiscard]] cv::Mat get_frame(const int& i) const { return frame_at(i); }
+
+        // Iterators
+        using const_iterator = FrameIterator<const FrameRange, cv::Mat>;
+        [[nodiscard]] const_iterator begin() const { return {this, 0}; }
+        [[nodiscard]] const_iterator end() const { return {this, count}; }
+
+        // Operators
+        cv::Mat operator[](const int& index) const;
+
+        // Image IO
+        [[nodiscard]] Quest::SeqErrorCodes render(const std::filesystem::path& output_path,
+            const RenderOptions& options = RenderOptions()) const;
+    };
+
+    // Range adaptors for FrameRange, applied with operator|:
+    // seq | views::frames_between(100, 200) | views::transform(grade) | views::stride(2)
+    namespace views {
+        struct FramesBetween { int first; int last; };
+        struct Stride { int n; };
+        struct Transform { std::function<cv::Mat(const cv::Mat&)> fn; };
+        struct Reverse {};
+
+        inline FramesBetween frames_between(const int first, const int last) { return {first, last}; } // [first, last)
+        inline Stride stride(const int n) { return {n}; } // Every nth frame, starting with the first
+        inline Transform transform(std::function<cv::Mat(const cv::Mat&)> fn) { return {std::move(fn)}; }
+        inline constexpr Reverse reverse {};
+
+        FrameRange operator|(const FrameRange& range, const FramesBetween& adaptor);
+        FrameRange operator|(const FrameRange& range, const Stride& adaptor);
+        FrameRange operator|(const FrameRange& range, const Transform& adaptor);
+        FrameRange operator|(const FrameRange& range, const Reverse& adaptor);
+    }
+
+    // Streams frames from a source path through per-frame stages to a sink path without opening the whole
+    // sequence. The stages and the sink run at the same time, with a bounded queue between each of them, so a slow
+    // stage holds back the ones feeding it instead of frames piling up in memory. Peak memory is a few frames per
+    // stage and a run takes about as long as its slowest stage. Stages can be given several threads, the first
+    // stage's also read the source, and frames reach the sink in order whatever order they come out of the stages
+    class Pipeline {
+    public:
+        using Stage = std::function<cv::Mat(const cv::Mat&)>;
+
+        struct StageStats {
+            std::string name;
+            int threads = 1;
+            int frames = 0;
+            double busy_seconds = 0; // Time spent producing frames, summed over the stage's threads
+            double blocked_seconds = 0; // Time spent waiting for the next stage to make room, summed the same way
+
+            // Frames per second the stage can produce while it's busy
+            [[nodiscard]] double get_frames_per_second() const {
+                return busy_seconds > 0 ? frames * threads / busy_seconds : 0;
+            }
+        };
+
+    private:
+        struct StageInfo {
+            std::string name;
+            Stage fn;
+            int threads;
+        };
+
+        std::filesystem::path source_path;
+        std::filesystem::path sink_path;
+        RenderOptions sink_options;
+        std::vector<StageInfo> stages;
+        int queue_frames = default_pipeline_queue_frames;
+        std::vector<StageStats> stats; // The source, then each stage, from the last run
+        double run_seconds = 0;
+
+    public:
+        // Constructors
+        Pipeline() = default;
+        Pipeline(const std::filesystem::path& new_source_path, const std::filesystem::path& new_sink_path,
+            const RenderOptions& new_sink_options = RenderOptions())
+            : source_path(new_source_path), sink_path(new_sink_path), sink_options(new_sink_options) {}
+
+        // Getters and setters
+        [[nodiscard]] std::filesystem::path get_source() const { return source_path; }
+        void set_source(const std::filesystem::path& new_source_path) { source_path = new_source_path; }
+        [[nodiscard]] std::filesystem::path get_sink() const { return sink_path; }
+        void set_sink(const std::filesystem::path& new_sink_path,
+            const RenderOptions& new_sink_options = RenderOptions()) {
+            sink_path = new_sink_path;
+            sink_options = new_sink_options;
+        }
+        [[nodiscard]] int get_queue_frames() const { return queue_frames; }
+        void set_queue_frames(const int& new_queue_frames) { queue_frames = std::max(1, new_queue_frames); }
+        [[nodiscard]] int get_stage_count() const { return static_cast<int>(stages.size()); }
+        [[nodiscard]] const std::vector<StageStats>& get_stats() const { return stats; }
+        [[nodiscard]] double get_run_seconds() const { return run_seconds; }
+
+        // Methods
+        // Stages run in the order they're added. fn runs on different frames at once when threads is more than 1.
+        // Stage threads hold a ThreadPool::Reservation for the run, so under ThreadPool::set_max_threads the busiest
+        // stages give threads up until they fit beside the global pool's last thread, and when there are more stages
+        // than that leaves, neighbouring stages share a thread
+        Pipeline& add_stage(Stage fn, const std::string& name = "", int threads = 1);
+        // BadPath if the source can't be read in full or the sink can't be written, UnsupportedExtension if either
+        // has an extension the library can't handle. A video that runs out before the frame count it reports ends
+        // the sink at its last frame, as open() does. An exception thrown by a stage stops the run and is rethrown
+        Quest::SeqErrorCodes run();
+    };
+
+    // Coroutine producing frames one at a time for a range-for loop, as returned by stream(). It can only be
+    // iterated once, and an exception thrown while producing a frame comes out of begin() or ++
+    class FrameGenerator {
+    public:
+        struct promise_type {
+            cv::Mat current;
+            std::exception_ptr error;
+
+            FrameGenerator get_return_object() {
+                return FrameGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            std::suspend_always yield_value(cv::Mat frame) {
+                current = std::move(frame);
+                return {};
+            }
+            void return_void() {}
+            void unhandled_exception() { error = std::current_exception(); }
+        };
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+
+        explicit FrameGenerator(const std::coroutine_handle<promise_type> new_handle) : handle(new_handle) {}
+
+        static void advance(const std::coroutine_handle<promise_type> to_advance) {
+            to_advance.resume();
+            if (to_advance.done() && to_advance.promise().error) {
+                std::rethrow_exception(std::exchange(to_advance.promise().error, nullptr));
+            }
+        }
+
+    public:
+        class iterator {
+            std::coroutine_handle<promise_type> handle;
+
+        public:
+            using iterator_concept = std::input_iterator_tag;
+            using value_type = cv::Mat;
+            using difference_type = std::ptrdiff_t;
+
+            iterator() = default;
+            explicit iterator(const std::coroutine_handle<promise_type> new_handle) : handle(new_handle) {}
+
+            cv::Mat& operator*() const { return handle.promise().current; }
+            iterator& operator++() {
+                advance(handle);
+                return *this;
+            }
+            void operator++(int) { ++*this; }
+            bool operator==(std::default_sentinel_t) const { return !handle || handle.done(); }
+        };
+
+        // Constructors
+        FrameGenerator(FrameGenerator&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+        FrameGenerator& operator=(FrameGenerator&& other) noexcept {
+            if (this != &other) {
+                if (handle) handle.destroy();
+                handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+        ~FrameGenerator() {
+            if (handle) handle.destroy();
+        }
+
+        // Iterators
+        iterator begin() {
+            if (handle && !handle.done()) advance(handle);
+            return iterator(handle);
+        }
+        std::default_sentinel_t end() { return {}; }
+    };
+
+    // Decoded frames of any input open() accepts, one at a time: for (cv::Mat& frame : Quest::stream(path)). A
+    // thread of its own reads up to prefetch frames ahead of the loop, and frames aren't kept once the loop moves
+    // past them, so memory stays at a few frames however long the input is. Throws a SeqException from the loop if
+    // the path can't be opened or a frame can't be read
+    FrameGenerator stream(std::filesystem::path path, int prefetch = default_stream_prefetch_frames);
+
     class Proxy : public ImageSeq {
         double scale;
     public:
         explicit Proxy(const ImageSeq& original, double resize_scale = 0.5);
+        explicit Proxy(const SeqView& original, double resize_scale = 0.5);
     };
 
     // Equality Operators
@@ -106,12 +883,27 @@ namespace Quest {
     inline bool MatNotEquals(const cv::Mat& mat_1, const cv::Mat& mat_2) { return !(MatEquals(mat_1, mat_2)); }
     bool operator==(const ImageSeq& seq_1, const ImageSeq& seq_2);
     inline bool operator!=(const ImageSeq& seq_1, const ImageSeq& seq_2) { return !(seq_1 == seq_2); }
+    bool operator==(const SeqView& view_1, const SeqView& view_2);
+    inline bool operator!=(const SeqView& view_1, const SeqView& view_2) { return !(view_1 == view_2); }
 
     // Helper functions
     void GiveMatAlpha(cv::Mat& image, const int& alpha_val);
     void GiveMatPureWhiteAlpha(cv::Mat& image);
     void GiveMatPureBlackAlpha(cv::Mat& image);
     bool HasFramePadding(const std::filesystem::path& file_path);
+    // OpenCV leaves its EXR codec switched off for security reasons unless OPENCV_IO_ENABLE_OPENEXR is set, so EXR
+    // files can't be opened or rendered until it is. This sets it for the process, unless it's set already. It
+    // changes the environment, which isn't safe while other threads may be reading it, so call it once at startup
+    // before starting any threads or using the library
+    void EnableOpenExr();
+
+    // Raw frame IO - these mirror cv::imread/cv::imwrite, returning an empty Mat or false on failure
+    cv::Mat ReadRawFrame(const std::filesystem::path& file_path);
+    bool WriteRawFrame(const std::filesystem::path& file_path, const cv::Mat& image);
+
+    // DPX frame IO - same conventions as the raw frame IO
+    cv::Mat ReadDpxFrame(const std::filesystem::path& file_path);
+    bool WriteDpxFrame(const std::filesystem::path& file_path, const cv::Mat& image);
 }
 
 #endif //QUEST_IMAGE_SEQ_LIB_LIBRARY_H